@@ -0,0 +1,421 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+//
+// micro benchmarks of the conversion, drawing, text, colormap, flow and plot
+// kernels. every kernel runs headless on seeded random inputs and prints one
+// csv row per case so that the output of two commits can be compared line by
+// line:
+//
+//   kernel,case,iterations,ns_per_iter,ns_per_pixel,mb_per_s,items_per_s
+//
+// usage: kortex-bench [kernel-filter] [seconds-per-case]
+//
+// ---------------------------------------------------------------------------
+#include "kortex/opencv_extensions.h"
+#include "kortex/plot.h"
+#include "kortex/colormap.h"
+#include "kortex/flow_overlay.h"
+#include "kortex/gui_window.h"
+#include "kortex/view_transform.h"
+#include <kortex/image.h>
+#include <kortex/color.h>
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+using namespace kortex;
+
+namespace {
+
+    struct Resolution {
+        const char* name;
+        int w, h;
+    };
+
+    const Resolution resolutions[] = {
+        { "vga",  640,  480 },
+        { "hd",  1280,  720 },
+        { "fhd", 1920, 1080 },
+        { "4k",  3840, 2160 },
+        { "8k",  7680, 4320 }
+    };
+    const int no_resolutions = sizeof(resolutions)/sizeof(resolutions[0]);
+
+    string filter;
+    double min_seconds = 0.5;
+    mt19937 rng( 1 );
+    int     failures = 0; // kernels whose output differs from their reference
+
+    struct BenchCase {
+        string kernel;
+        string name;
+        double pixels; // per iteration
+        double bytes;
+        double items;
+        BenchCase( const string& k, const string& n, double p, double b, double i ) {
+            kernel = k; name = n; pixels = p; bytes = b; items = i;
+        }
+    };
+
+    double elapsed( const function<void()>& f, int reps ) {
+        chrono::high_resolution_clock::time_point t0 = chrono::high_resolution_clock::now();
+        for( int r=0; r<reps; r++ )
+            f();
+        chrono::high_resolution_clock::time_point t1 = chrono::high_resolution_clock::now();
+        return chrono::duration<double>( t1-t0 ).count();
+    }
+
+    // the repetition count is doubled until a batch takes a fifth of the
+    // case budget; the reported time is the median of five batches.
+    void run( const BenchCase& bc, const function<void()>& f ) {
+        if( !filter.empty() && bc.kernel.find( filter ) == string::npos )
+            return;
+        f();
+        int reps = 1;
+        while( elapsed( f, reps ) < min_seconds/5 && reps < (1<<20) )
+            reps *= 2;
+        vector<double> t;
+        for( int k=0; k<5; k++ )
+            t.push_back( elapsed( f, reps ) / reps );
+        sort( t.begin(), t.end() );
+        double s = t[2];
+
+        printf( "%s,%s,%d,%.1f,%.4f,%.1f,%.1f\n", bc.kernel.c_str(), bc.name.c_str(), 5*reps, s*1e9,
+                bc.pixels > 0 ? s*1e9/bc.pixels : 0.0,
+                bc.bytes  > 0 ? bc.bytes/s/1e6  : 0.0,
+                bc.items  > 0 ? bc.items/s      : 0.0 );
+        fflush( stdout );
+    }
+
+    void random_image( int w, int h, ImageType type, Image& img ) {
+        img.create( w, h, type );
+        uniform_int_distribution<int> d( 0, 255 );
+        int rw = w * img.ch();
+        for( int y=0; y<h; y++ ) {
+            uchar* row = img.get_row_u( y );
+            for( int x=0; x<rw; x++ )
+                row[x] = (uchar)d( rng );
+        }
+    }
+
+    IplImage* random_ipl( int w, int h, int nc ) {
+        IplImage* ipl = cvCreateImage( cvSize(w,h), IPL_DEPTH_8U, nc );
+        uniform_int_distribution<int> d( 0, 255 );
+        for( int y=0; y<h; y++ ) {
+            uchar* row = (uchar*)( ipl->imageData + y*ipl->widthStep );
+            for( int x=0; x<w*nc; x++ )
+                row[x] = (uchar)d( rng );
+        }
+        return ipl;
+    }
+
+    string res_case( const Resolution& r, int nc ) {
+        char buf[64];
+        sprintf( buf, "%s_%dch", r.name, nc );
+        return buf;
+    }
+
+    void bench_conversions() {
+        for( int k=0; k<no_resolutions; k++ ) {
+            const Resolution& r = resolutions[k];
+            double np = double(r.w) * r.h;
+            for( int nc=1; nc<=3; nc+=2 ) {
+                Image img;
+                random_image( r.w, r.h, nc == 1 ? IT_U_GRAY : IT_U_PRGB, img );
+                IplImage* ipl = cvCreateImage( cvSize(r.w,r.h), IPL_DEPTH_8U, 3 );
+                run( BenchCase( "copy_image_to_color_ipl", res_case( r, nc ), np, np*(nc+3), np ),
+                     [&]() { copy_image_to_color_ipl( &img, ipl ); } );
+                cvReleaseImage( &ipl );
+
+                IplImage* src = random_ipl( r.w, r.h, nc );
+                Image dst;
+                run( BenchCase( "copy_ipl_to_image", res_case( r, nc ), np, np*2*nc, np ),
+                     [&]() { copy_ipl_to_image( src, &dst ); } );
+                cvReleaseImage( &src );
+            }
+        }
+
+        IplImage* src = random_ipl( 1920, 1080, 3 );
+        const int wins[] = { 31, 101, 301, 1001 };
+        for( int k=0; k<4; k++ ) {
+            int w = wins[k];
+            IplImage* dst = cvCreateImage( cvSize(w,w), IPL_DEPTH_8U, 3 );
+            uniform_int_distribution<int> dx( 0, 1919 ), dy( 0, 1079 );
+            char buf[64];
+            sprintf( buf, "fhd_win%d", w );
+            run( BenchCase( "copy_to_color_ipl", buf, double(w)*w, 6.0*w*w, double(w)*w ),
+                 [&]() { copy_to_color_ipl( src, dx(rng), dy(rng), w, dst ); } );
+            cvReleaseImage( &dst );
+        }
+        cvReleaseImage( &src );
+    }
+
+    void bench_overlay() {
+        for( int k=0; k<no_resolutions; k++ ) {
+            const Resolution& r = resolutions[k];
+            double np = double(r.w) * r.h;
+            IplImage* ipl = random_ipl( r.w, r.h, 3 );
+            vector<int> occ( r.w*r.h );
+            bernoulli_distribution d( 0.5 );
+            for( size_t i=0; i<occ.size(); i++ )
+                occ[i] = d( rng );
+            run( BenchCase( "overlay_region", res_case( r, 3 ), np, np*(4+3), np ),
+                 [&]() { overlay_region( ipl, &occ[0] ); } );
+            cvReleaseImage( &ipl );
+        }
+    }
+
+    void bench_text() {
+        const int counts[] = { 1, 10, 100, 1000 };
+        for( int k=0; k<3; k++ ) {
+            const Resolution& r = resolutions[k+1];
+            double np = double(r.w) * r.h;
+            for( int c=0; c<4; c++ ) {
+                Image img;
+                random_image( r.w, r.h, IT_U_PRGB, img );
+                uniform_int_distribution<int> dx( 0, r.w-100 ), dy( 20, r.h-1 );
+                vector<ImageTextInfo> info( counts[c] );
+                for( int i=0; i<counts[c]; i++ ) {
+                    info[i].x    = dx( rng );
+                    info[i].y    = dy( rng );
+                    info[i].text = "kortex " + to_string( (long long)i );
+                }
+                char buf[64];
+                sprintf( buf, "%s_%dstrings", r.name, counts[c] );
+                run( BenchCase( "write_on_image_cv", buf, np, np*6, counts[c] ),
+                     [&]() { write_on_image_cv( &img, info ); } );
+            }
+        }
+    }
+
+    void bench_primitives() {
+        const int counts[] = { 1000, 10000, 100000 };
+        const int w = 1920, h = 1080;
+        IplImage* ipl = random_ipl( w, h, 3 );
+        Color col( 255, 128, 0 );
+        for( int c=0; c<3; c++ ) {
+            int n = counts[c];
+            vector<int> xy( 4*n );
+            uniform_int_distribution<int> dx( -50, w+50 ), dy( -50, h+50 );
+            for( int i=0; i<n; i++ ) {
+                xy[4*i+0] = dx( rng ); xy[4*i+1] = dy( rng );
+                xy[4*i+2] = dx( rng ); xy[4*i+3] = dy( rng );
+            }
+            char buf[64];
+            sprintf( buf, "fhd_%d", n );
+            run( BenchCase( "draw_line", buf, 0, 0, n ), [&]() {
+                    for( int i=0; i<n; i++ )
+                        draw_line( ipl, xy[4*i], xy[4*i+1], xy[4*i+2], xy[4*i+3], &col, 1 );
+                } );
+            run( BenchCase( "draw_rectangle", buf, 0, 0, n ), [&]() {
+                    for( int i=0; i<n; i++ )
+                        draw_rectangle( ipl, xy[4*i], xy[4*i+1], xy[4*i+2]%64, xy[4*i+3]%64, &col, 1 );
+                } );
+            run( BenchCase( "draw_circle", buf, 0, 0, n ), [&]() {
+                    for( int i=0; i<n; i++ )
+                        draw_circle( ipl, xy[4*i], xy[4*i+1], 1+abs( xy[4*i+2] )%32, &col, 1 );
+                } );
+            run( BenchCase( "draw_marker", buf, 0, 0, n ), [&]() {
+                    for( int i=0; i<n; i++ )
+                        draw_marker( ipl, xy[4*i], xy[4*i+1], &col, 2 );
+                } );
+        }
+        cvReleaseImage( &ipl );
+    }
+
+    // false color of a float field through both lut sizes, and the field
+    // blended over a color image
+    void bench_colormap() {
+        uniform_real_distribution<float> d( 0.0f, 10.0f );
+        for( int k=0; k<no_resolutions; k++ ) {
+            const Resolution& r = resolutions[k];
+            double np = double(r.w) * r.h;
+            Image field( r.w, r.h, IT_F_GRAY );
+            for( int y=0; y<r.h; y++ ) {
+                float* row = field.get_row_f( y );
+                for( int x=0; x<r.w; x++ )
+                    row[x] = d( rng );
+            }
+            Image base, out;
+            random_image( r.w, r.h, IT_U_PRGB, base );
+            const int sizes[] = { 256, 4096 };
+            for( int s=0; s<2; s++ ) {
+                Colormap cmap( CMAP_TURBO, sizes[s] );
+                char buf[64];
+                sprintf( buf, "%s_lut%d", r.name, sizes[s] );
+                run( BenchCase( "colormap_image", buf, np, np*(4+3), np ),
+                     [&]() { colormap_image( &field, cmap, 0.0f, 10.0f, &out ); } );
+                run( BenchCase( "blend_colormap", buf, np, np*(4+3+3), np ),
+                     [&]() { blend_colormap( &base, &field, cmap, 0.0f, 10.0f, 0.5f, &out ); } );
+            }
+        }
+    }
+
+    // hsv coloring of a dense flow field, and a headless 1080p window
+    // drawing the quiver of a full hd field at a few arrow spacings
+    void bench_flow() {
+        normal_distribution<float> d( 0.0f, 4.0f );
+        for( int k=0; k<no_resolutions; k++ ) {
+            const Resolution& r = resolutions[k];
+            double np = double(r.w) * r.h;
+            Image u( r.w, r.h, IT_F_GRAY ), v( r.w, r.h, IT_F_GRAY ), out;
+            for( int y=0; y<r.h; y++ ) {
+                float* ur = u.get_row_f( y );
+                float* vr = v.get_row_f( y );
+                for( int x=0; x<r.w; x++ ) {
+                    ur[x] = d( rng );
+                    vr[x] = d( rng );
+                }
+            }
+            run( BenchCase( "flow_to_color", res_case( r, 2 ), np, np*(8+3), np ),
+                 [&]() { flow_to_color( &u, &v, 10.0f, &out ); } );
+
+            if( r.w != 1920 ) continue;
+            GUIWindow win;
+            win.set_headless( true );
+            win.create_display( r.w, r.h );
+            FlowOverlay flow;
+            flow.set_flow( &u, &v );
+            ViewTransform view;
+            const int spacings[] = { 4, 8, 16, 32 };
+            for( int s=0; s<4; s++ ) {
+                flow.set_spacing( spacings[s] );
+                int arrows = ( r.w/spacings[s] ) * ( r.h/spacings[s] );
+                char buf[64];
+                sprintf( buf, "fhd_spacing%d", spacings[s] );
+                run( BenchCase( "flow_quiver", buf, np, 0, arrows ),
+                     [&]() { win.reset_display(); flow.draw( &win, view ); } );
+            }
+        }
+    }
+
+    // full headless renders: grid, labels and data of a fresh plot canvas
+    void bench_plot() {
+        const int counts[] = { 1000, 100000, 10000000 };
+        const int types [] = { PT_LINE, PT_DOT, PT_DENSITY };
+        const char* tnames[] = { "line", "dot", "density" };
+        normal_distribution<float> d( 0.0f, 1.0f );
+        for( int c=0; c<3; c++ ) {
+            int n = counts[c];
+            vector<float> ys( n );
+            for( int i=0; i<n; i++ )
+                ys[i] = d( rng );
+            for( int t=0; t<3; t++ ) {
+                Plot p;
+                p.add_series( &ys[0], n );
+                p.set_type( types[t] );
+                Image out;
+                char buf[64];
+                sprintf( buf, "1024x512_%s_%d", tnames[t], n );
+                run( BenchCase( "plot_render", buf, 1024.0*512, 0, n ),
+                     [&]() { p.render( 1024, 512, &out ); } );
+            }
+        }
+    }
+
+    // reference for the indexed search: the screen distance to every
+    // sample, ties to the lower index
+    int closest_linear( const Plot& p, const vector<float>& xs, const vector<float>& ys, double qx, double qy ) {
+        float tx, ty;
+        p.data_to_screen( qx, qy, tx, ty );
+        int   id   = 0;
+        float best = 1e20f;
+        for( int i=0; i<(int)xs.size(); i++ ) {
+            float gx, gy;
+            p.data_to_screen( xs[i], ys[i], gx, gy );
+            float d = (gy-ty)*(gy-ty) + (gx-tx)*(gx-tx);
+            if( d < best ) {
+                best = d;
+                id   = i;
+            }
+        }
+        return id;
+    }
+
+    // nearest sample queries on the view of a render. the indexed search is
+    // checked against the linear scan before it is timed; queries reach far
+    // above and below the series where a search along x alone degrades.
+    void bench_plot_closest() {
+        if( !filter.empty() && string( "plot_closest" ).find( filter ) == string::npos )
+            return;
+        const int n  = 1000000;
+        const int nq = 1000;
+        normal_distribution<float> d( 0.0f, 1.0f );
+        for( int c=0; c<2; c++ ) {
+            bool monotone = ( c == 0 );
+            vector<float> xs( n ), ys( n );
+            float v = 0.0f;
+            for( int i=0; i<n; i++ ) {
+                v += d( rng );
+                xs[i] = monotone ? float( i ) : d( rng );
+                ys[i] = monotone ? v          : d( rng );
+            }
+            float x0 = *min_element( xs.begin(), xs.end() ), x1 = *max_element( xs.begin(), xs.end() );
+            float y0 = *min_element( ys.begin(), ys.end() ), y1 = *max_element( ys.begin(), ys.end() );
+
+            Plot p;
+            p.add_series( &xs[0], &ys[0], n );
+            p.set_type( PT_DOT );
+            Image out;
+            p.render( 1024, 512, &out );
+
+            vector<double> qx( nq ), qy( nq );
+            uniform_real_distribution<double> u( 0.0, 1.0 );
+            for( int q=0; q<nq; q++ ) {
+                qx[q] = x0 + u( rng )*( x1-x0 );
+                qy[q] = y0 + ( 20.0*u( rng ) - 9.5 )*( y1-y0 );
+            }
+
+            int mismatches = 0;
+            for( int q=0; q<nq; q+=5 )
+                if( p.closest_sample( 0, qx[q], qy[q] ) != closest_linear( p, xs, ys, qx[q], qy[q] ) )
+                    mismatches++;
+            const char* name = monotone ? "1024x512_monotone_1000000" : "1024x512_scatter_1000000";
+            if( mismatches ) {
+                fprintf( stderr, "plot_closest %s: %d of %d queries differ from the linear scan\n", name, mismatches, nq/5 );
+                failures++;
+            }
+
+            volatile int sink = 0;
+            run( BenchCase( "plot_closest", name, 0, 0, nq ),
+                 [&]() { for( int q=0; q<nq; q++ ) sink = p.closest_sample( 0, qx[q], qy[q] ); } );
+        }
+    }
+}
+
+int main( int argc, char** argv ) {
+    if( argc > 1 ) filter      = argv[1];
+    if( argc > 2 ) min_seconds = atof( argv[2] );
+
+    printf( "kernel,case,iterations,ns_per_iter,ns_per_pixel,mb_per_s,items_per_s\n" );
+    bench_conversions();
+    bench_overlay();
+    bench_text();
+    bench_primitives();
+    bench_colormap();
+    bench_flow();
+    bench_plot();
+    bench_plot_closest();
+    return failures ? 1 : 0;
+}
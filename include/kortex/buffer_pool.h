@@ -0,0 +1,83 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_BUFFER_POOL_H
+#define KORTEX_BUFFER_POOL_H
+
+#include <vector>
+#include <mutex>
+#include <cstddef>
+#include <cstdio>
+
+using std::vector;
+
+struct _IplImage;
+typedef struct _IplImage IplImage;
+
+namespace kortex {
+
+    struct BufferPoolStats {
+        size_t hits;         // acquisitions served from the free lists
+        size_t misses;       // acquisitions that allocated
+        size_t dropped;      // releases freed because the pool was full
+        size_t bytes_held;   // cached in the free lists
+        size_t bytes_out;    // handed out and not yet released
+
+        double hit_rate() const { return hits+misses ? double(hits)/(hits+misses) : 0.0; }
+        void   print( FILE* fp=stdout ) const;
+    };
+
+    // thread-safe cache of large, 64 byte aligned pixel buffers. requests
+    // are rounded up to size classes of four steps per power of two (at
+    // most 25% slack), released buffers go back to the free list of their
+    // class and are handed out again for any request of that class. the
+    // default capacity holds a few 1080p frames.
+    class BufferPool {
+    public:
+        BufferPool( size_t capacity_in_bytes=size_t(32)<<20 );
+        ~BufferPool();
+
+        void* acquire( size_t bytes );
+        void  release( void* p, size_t bytes );  // bytes as passed to acquire
+
+        // the free lists never hold more than this, extra releases are freed
+        void  set_capacity( size_t bytes );
+        void  trim();
+
+        BufferPoolStats stats() const;
+
+        static size_t class_size( size_t bytes );
+
+    private:
+        mutable std::mutex     mtx;
+        vector< vector<void*> > free_lists;
+        size_t capacity;
+        BufferPoolStats st;
+
+        void trim_to( size_t bytes );
+
+        BufferPool( const BufferPool& );
+        BufferPool& operator=( const BufferPool& );
+    };
+
+    // the pool shared by the windows and the conversion routines
+    BufferPool& buffer_pool();
+
+    // 8 bit images whose pixels come from buffer_pool(). release them with
+    // release_pooled_image, which also accepts images made by cvCreateImage.
+    IplImage* create_pooled_image( int w, int h, int nc );
+    void      release_pooled_image( IplImage** ipl );
+
+}
+
+#endif
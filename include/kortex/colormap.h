@@ -0,0 +1,71 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_COLORMAP_H
+#define KORTEX_COLORMAP_H
+
+#include <kortex/types.h>
+#include <vector>
+#include <stdint.h>
+
+using std::vector;
+
+namespace kortex {
+
+    class Image;
+
+    enum ColormapType { CMAP_GRAY=0, CMAP_JET, CMAP_VIRIDIS, CMAP_TURBO, CMAP_DIVERGING, CMAP_COUNT };
+
+    const char* colormap_name( ColormapType type );
+
+    // false color lookup table of 256 or 4096 entries. every entry is packed
+    // into 4 bytes so that a row is mapped with one gather per pixel; values
+    // are clamped to [vmin,vmax] and nans map to the first entry.
+    class Colormap {
+    public:
+        Colormap( ColormapType type=CMAP_JET, int size=256 );
+        void set( ColormapType type, int size=256 );
+
+        ColormapType type() const { return ctype; }
+        int          size() const { return (int)rgbx.size(); }
+        void get( int i, uchar& r, uchar& g, uchar& b ) const;
+
+        // n values -> n packed rgb (or bgr) pixels
+        void map_row( const float* src, int n, float vmin, float vmax, uchar* dst, bool bgr=false ) const;
+        void map_row( const uchar* src, int n, float vmin, float vmax, uchar* dst, bool bgr=false ) const;
+
+    private:
+        ColormapType     ctype;
+        vector<uint32_t> rgbx;   // r | g<<8 | b<<16
+        vector<uint32_t> bgrx;   // b | g<<8 | r<<16
+    };
+
+    // value range of a gray image without its nans, [0,1] if there is none
+    void colormap_range( const Image* im, float& vmin, float& vmax );
+
+    // dst = ( base*(256-a) + over*a ) >> 8 byte by byte, a = alpha*256
+    void blend_row( const uchar* base, const uchar* over, int nbytes, float alpha, uchar* dst );
+
+    // maps a gray image (IT_U_GRAY or IT_F_GRAY) to IT_U_PRGB. vmin >= vmax
+    // uses the range of the image.
+    void colormap_image( const Image* im, const Colormap& cmap, float vmin, float vmax, Image* out );
+
+    // alpha-composites the colormapped scalar field over base (IT_U_PRGB or
+    // IT_U_GRAY) into an IT_U_PRGB image. nan pixels of the field are
+    // transparent. vmin >= vmax uses the range of the field.
+    void blend_colormap( const Image* base, const Image* field, const Colormap& cmap,
+                         float vmin, float vmax, float alpha, Image* out );
+
+}
+
+#endif
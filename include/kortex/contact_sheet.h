@@ -0,0 +1,128 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_CONTACT_SHEET_H
+#define KORTEX_CONTACT_SHEET_H
+
+#include "kortex/gui_window.h"
+#include <kortex/types.h>
+
+#include <vector>
+#include <string>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+using std::vector;
+using std::string;
+
+namespace kortex {
+
+    // shows the images of a file list as a scrollable grid of thumbnails.
+    // only the rows in view (and one screen ahead) are requested: a pool of
+    // worker threads decodes and downscales them, the results live in an lru
+    // cache of bounded size and optionally in a sidecar directory so that a
+    // folder is decoded only once. clicking a cell opens the image in an
+    // ImageGUI.
+    //
+    // keys: j/k one row down/up, space/b one page down/up, g/G first/last
+    // row, q quit.
+    class ContactSheet {
+    public:
+        ContactSheet();
+        ~ContactSheet();
+
+        void set_files( const vector<string>& files );
+        void set_thumbnail_size( int ts )   { tsize = ts; }
+        void set_cache_size( int n )        { cache_capacity = n; }
+        void set_workers( int n )           { no_workers = n; }
+        void set_sidecar( const string& dir ) { sidecar = dir; }
+
+        void create( int w, int h );
+        void display();
+
+    private:
+        struct Thumb {
+            int w, h;
+            vector<uchar> rgb;
+        };
+        typedef std::list<int> LruList;
+        struct CacheEntry {
+            Thumb thumb;
+            LruList::iterator lru;
+        };
+
+        GUIWindow      win;
+        vector<string> files;
+        string         sidecar;
+        int            tsize;
+        int            cache_capacity;
+        int            no_workers;
+
+        int  ww, wh;           // window size
+        int  cols;
+        int  cell_w, cell_h;
+        int  scroll;           // pixels from the top of the grid
+        int  hover;
+        bool dirty;
+
+        // lru thumbnail cache, owned by the display thread
+        std::unordered_map<int,CacheEntry> cache;
+        LruList lru;
+
+        // worker pool
+        vector<std::thread>     workers;
+        std::mutex              mtx;
+        std::condition_variable cv;
+        std::deque<int>         jobs;
+        std::unordered_set<int> pending;   // queued or being decoded
+        vector< std::pair<int,Thumb> > results;
+        bool                    stop;
+
+        void start_workers();
+        void stop_workers();
+        void work();
+        bool load_thumbnail( const string& file, Thumb& t ) const;
+        bool load_sidecar  ( const string& file, Thumb& t ) const;
+        void save_sidecar  ( const string& file, const Thumb& t ) const;
+        string sidecar_file( const string& file ) const;
+
+        void collect();
+        void schedule();
+        int  capacity() const;
+        void touch( int i );
+        void evict();
+
+        void layout();
+        int  no_rows() const;
+        int  max_scroll() const;
+        void scroll_to( int s );
+        int  cell_at( int x, int y ) const;
+        void draw();
+        bool catch_keyboard();
+        void catch_mouse();
+        void open_image( int i );
+
+        ContactSheet( const ContactSheet& );
+        ContactSheet& operator=( const ContactSheet& );
+    };
+
+    void contact_sheet( const vector<string>& files, int w=1280, int h=800 );
+
+}
+
+#endif
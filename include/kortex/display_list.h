@@ -0,0 +1,108 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_DISPLAY_LIST_H
+#define KORTEX_DISPLAY_LIST_H
+
+#include "kortex/color.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+using std::string;
+using std::vector;
+
+struct _IplImage;
+typedef struct _IplImage IplImage;
+
+namespace kortex {
+
+    class Image;
+
+    // retained list of the paint operations of a GUIWindow. the operations
+    // are packed into a byte stream (an opcode followed by variable length
+    // integers) in the coordinates of a w x h display. every reset_display
+    // starts a new frame. a frame can be replayed onto a target of any size:
+    // coordinates, thicknesses and fonts are scaled by the ratio of the
+    // target to the recorded display. images drawn again with the same
+    // pixels, like the cached layers repainted on every redraw, are stored
+    // once and referenced by the later frames.
+    class DisplayList {
+    public:
+        DisplayList();
+
+        void clear();
+        void begin( int w, int h );
+
+        int    w() const { return sw; }
+        int    h() const { return sh; }
+        int    no_frames() const { return (int)frames.size(); }
+        size_t size_in_bytes() const { return buf.size(); }
+
+        // raw access to the packed operations, e.g. to ship them elsewhere
+        const uchar* data() const { return buf.data(); }
+        void assign( int w, int h, const uchar* data, size_t n );
+
+        // recording, mirrors the GUIWindow paint operations
+        void set_color    ( const Color& col );
+        void set_thickness( int t );
+        void set_font     ( float hs, float vs, float shear, float thickness );
+
+        void reset_display();
+        void save_display();
+        void clear_display();
+
+        void draw_line     ( int x0, int y0, int x1, int y1 );
+        void draw_ray      ( int x0, int y0, float length, float angle );
+        void draw_rectangle( int x, int y, int dw, int dh );
+        void draw_circle   ( int x, int y, int dr );
+        void draw_polygon  ( const int* xy, int no_points );
+        void draw_polylines( const int* xy, const int* counts, int no_lines );
+        void draw_image    ( const uchar* rgb, const uchar* mask, int x, int y, int iw, int ih );
+        void mark          ( int x, int y, int thickness );
+        void mark_region   ( const int* mark, bool permanent );
+        void write         ( int x, int y, const string& text );
+
+        // draws frame (the last one for -1) over the current content of the
+        // target, which plays the role of the window background. earlier
+        // frames only contribute their brush settings and whatever they
+        // made permanent with save_display or a permanent mark_region.
+        void replay( IplImage* target, int frame=-1 ) const;
+        void render( const Image* background, Image* out, int frame=-1 ) const;
+        void render( int ow, int oh, Image* out, int frame=-1 ) const;
+
+        void save( const string& file ) const;
+        void load( const string& file );
+
+    private:
+        vector<uchar>  buf;
+        vector<size_t> frames;     // offset of the first operation of each frame
+        vector<uchar>  persists;   // frame changes the background
+        int sw, sh;
+        int last_color;            // packed rgb of the brush, -1 if unknown
+        int last_thickness;        // INT_MIN if unknown
+        std::unordered_multimap<size_t,size_t> images; // pixel hash -> offset of the image
+
+        void put_op   ( int op );
+        void put_uint ( unsigned v );
+        void put_int  ( int v );
+        void put_float( float v );
+        void put_bytes( const uchar* p, size_t n );
+
+        void index_frames();
+    };
+
+}
+
+#endif
@@ -0,0 +1,73 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_FEATURE_OVERLAY_H
+#define KORTEX_FEATURE_OVERLAY_H
+
+#include "kortex/color.h"
+#include <vector>
+
+using std::vector;
+
+namespace kortex {
+
+    class  GUIWindow;
+    struct ViewTransform;
+
+    // large keypoint / detection sets drawn over an image. features are
+    // bucketed into a uniform grid over image coordinates with a pyramid of
+    // per-cell counts so that a frame only visits the cells in the viewport.
+    // when the viewport holds more features than max_primitives, one
+    // aggregated marker is splatted per cell instead.
+    class FeatureOverlay {
+    public:
+        FeatureOverlay();
+
+        void clear();
+        void add( float x, float y, float radius=0.0f );
+        void build( int cell_size=16 );
+
+        void set_color( const Color& col ) { color = col; }
+        void set_max_primitives( int n )   { max_primitives = n; }
+
+        void draw( GUIWindow* win, const ViewTransform& view ) const;
+
+        int  size() const { return (int)fx.size(); }
+
+    private:
+        vector<float> fx, fy, fr;    // sorted by cell after build()
+
+        float ox, oy;                // grid origin
+        int   cell;                  // level 0 cell size in image pixels
+        vector<int> cell_start;      // level 0 cell -> first feature
+
+        struct Level {
+            int w, h;
+            vector<int>   count;
+            vector<float> sx, sy;    // coordinate sums for cell centroids
+        };
+        vector<Level> levels;
+
+        Color color;
+        int   max_primitives;
+        bool  bbuilt;
+
+        void cell_range( const Level& lv, int lsz, const ViewTransform& view, int dw, int dh,
+                         int& cx0, int& cy0, int& cx1, int& cy1 ) const;
+        void draw_features  ( GUIWindow* win, const ViewTransform& view ) const;
+        void draw_aggregated( GUIWindow* win, const ViewTransform& view, int l ) const;
+    };
+
+}
+
+#endif
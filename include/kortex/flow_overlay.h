@@ -0,0 +1,96 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_FLOW_OVERLAY_H
+#define KORTEX_FLOW_OVERLAY_H
+
+#include "kortex/color.h"
+#include "kortex/view_transform.h"
+#include <kortex/types.h>
+#include <vector>
+
+using std::vector;
+
+namespace kortex {
+
+    class  Image;
+    class  GUIWindow;
+
+    enum FlowDrawMode { FLOW_QUIVER=0, FLOW_HSV, FLOW_HSV_QUIVER };
+
+    // dense flow field (u and v planes in image pixels) drawn over an image.
+    // quiver arrows sit on a grid of image pixels whose step follows the
+    // zoom, so there is about one arrow every spacing display pixels however
+    // large the field is, and all arrows of a frame are drawn with one
+    // polyline batch. the hsv mode colors every display pixel by flow
+    // direction (hue) and magnitude (saturation).
+    class FlowOverlay {
+    public:
+        FlowOverlay();
+
+        // the planes are referenced, not copied. stride is in floats, 0
+        // means w. call it again after the planes are changed in place.
+        void set_flow( const float* u, const float* v, int w, int h, int stride=0 );
+        void set_flow( const Image* u, const Image* v );
+
+        void set_mode( FlowDrawMode m )   { mode = m; }
+        void set_spacing( int px )        { spacing = px; }
+        void set_arrow_scale( float s )   { arrow_scale = s; }
+        void set_color( const Color& col ) { color = col; }
+        // magnitude of full saturation in hsv mode, 0 for the largest
+        // visible magnitude
+        void set_max_magnitude( float m ) { max_mag = m; hsv_valid = false; }
+
+        FlowDrawMode get_mode() const { return mode; }
+
+        void draw( GUIWindow* win, const ViewTransform& view ) const;
+
+    private:
+        const float* fu;
+        const float* fv;
+        int   fw, fh, fstride;
+
+        FlowDrawMode mode;
+        int   spacing;
+        float arrow_scale;
+        float max_mag;
+        Color color;
+
+        // per frame scratch space
+        mutable vector<int>   arrow_xy;
+        mutable vector<int>   arrow_n;
+        mutable vector<float> su, sv;
+
+        // colored field of the view it was built for, only repainted while
+        // the view, the field and max_mag are unchanged
+        mutable vector<uchar>  rgb;
+        mutable ViewTransform  hsv_view;
+        mutable int            hsv_dw, hsv_dh;
+        mutable int            hsv_x, hsv_y, hsv_w, hsv_h;
+        mutable bool           hsv_valid;
+
+        void draw_quiver( GUIWindow* win, const ViewTransform& view ) const;
+        void draw_hsv   ( GUIWindow* win, const ViewTransform& view ) const;
+        void build_hsv  ( const ViewTransform& view, int dw, int dh ) const;
+    };
+
+    // n flow vectors -> packed rgb: hue from the direction, saturation from
+    // magnitude / max_mag. nan vectors are black.
+    void flow_color_row( const float* u, const float* v, int n, float max_mag, uchar* rgb );
+
+    // IT_F_GRAY u, v -> IT_U_PRGB. max_mag <= 0 uses the largest magnitude.
+    void flow_to_color( const Image* u, const Image* v, float max_mag, Image* out );
+
+}
+
+#endif
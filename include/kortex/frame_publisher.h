@@ -0,0 +1,89 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_FRAME_PUBLISHER_H
+#define KORTEX_FRAME_PUBLISHER_H
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+using std::string;
+
+namespace kortex {
+
+    class Image;
+    class DisplayList;
+
+    // live frames for out-of-process viewers over a posix shared memory
+    // ring (/dev/shm/<name>). the producer copies each frame once into the
+    // slot after the newest one and never waits for readers; every slot is
+    // guarded by a sequence counter (odd while being written) so a reader
+    // that falls behind detects an overwritten slot and retries with the
+    // newest frame instead of holding the producer back.
+    class FramePublisher {
+    public:
+        FramePublisher();
+        ~FramePublisher();
+
+        // max_bytes bounds the pixel data of a frame, max_overlay_bytes the
+        // size of its display list
+        void create( const string& name, size_t max_bytes, size_t max_overlay_bytes=1<<20, int no_slots=4 );
+        void destroy();
+
+        void publish( const Image* im, const DisplayList* overlay=NULL );
+
+        uint64_t no_published() const { return frame; }
+
+    private:
+        string   sname;
+        int      fd;
+        void*    base;
+        size_t   bytes;
+        uint64_t frame;
+
+        FramePublisher( const FramePublisher& );
+        FramePublisher& operator=( const FramePublisher& );
+    };
+
+    class FrameSubscriber {
+    public:
+        FrameSubscriber();
+        ~FrameSubscriber();
+
+        // false if no publisher has created the ring yet
+        bool open( const string& name );
+        void close();
+        bool is_open() const { return base != NULL; }
+
+        // copies the newest frame if it is newer than the last one read.
+        // overlay may be NULL.
+        bool latest( Image* im, DisplayList* overlay=NULL );
+
+        uint64_t frame_id() const { return last; }
+        uint64_t no_skipped() const { return nskipped; }
+
+    private:
+        int      fd;
+        void*    base;
+        size_t   bytes;
+        uint64_t last;
+        uint64_t nskipped;
+
+        FrameSubscriber( const FrameSubscriber& );
+        FrameSubscriber& operator=( const FrameSubscriber& );
+    };
+
+}
+
+#endif
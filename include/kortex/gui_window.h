@@ -29,6 +29,10 @@ struct CvFont;
 namespace kortex {
 
     class Image;
+    class InputLog;
+    class DisplayList;
+    class InputSession;
+    struct ReplayStats;
 
     struct callback_info {
         int xstart;
@@ -57,11 +61,23 @@ namespace kortex {
         void set_image( const Image *im );
         void set_image( const uchar *im, const int& w, const int& h, const int& nc );
         void set_image( const string& imname );
+        void set_image( const Image* im, float vmin, float vmax, bool single_channel, int factor=1 );
+
+        // loads the image on a worker thread. 8 bit binary pgm/ppm files are
+        // memory mapped and converted row by row, and poll_image copies the
+        // finished rows to the display; other formats show a placeholder
+        // until they are decoded. call poll_image from the display loop: it
+        // finishes the load and resets the display when new rows arrived.
+        // calls that replace or paint into the background cancel the load.
+        void set_image_async( const string& imname );
+        bool poll_image();
+        bool is_loading() const { return async != NULL; }
 
         void      create_display( const int& w, const int& h );
 
         const IplImage* get_display() const;
         const IplImage* get_original_display() const;
+        IplImage*       get_original_display();
 
         void  set_display( const GUIWindow* src_wnd, const int& x, const int& y, const int& wsz );
         void  set_original_display( const GUIWindow* src_wnd, const int& x, const int& y, const int& wsz );
@@ -69,6 +85,22 @@ namespace kortex {
         void set_margin( const int& m ) { margin=m; }
 
         void save_screen( const string& file ) const;
+        void get_screen ( Image* im ) const;
+
+        // headless windows only draw into their display buffers: no highgui
+        // window is created and the window calls are no-ops. safe to use from
+        // worker threads.
+        void set_headless( bool state );
+        bool is_headless() const { return bheadless; }
+
+        // records the input polled by wait() into log, or replays a log
+        // headless at full speed (see InputSession)
+        void record_input( InputLog* log );
+        void replay_input( const InputLog* log, ReplayStats* stats );
+
+        // appends the paint operations from now on to dl (NULL stops). the
+        // list can later be replayed at any resolution.
+        void record_display( DisplayList* dl );
 
         // window paint operations
         void draw_line     ( int x0, int y0, int x1, int y1 );
@@ -76,6 +108,8 @@ namespace kortex {
         void draw_rectangle( int x, int y, int dw, int dh );
         void draw_circle   ( int x, int y, int dr );
         void draw_polygon  ( int* xy, int no_points );
+        void draw_polylines( const int* xy, const int* counts, int no_lines );
+        void draw_image    ( const uchar* rgb, const uchar* mask, int x, int y, int iw, int ih );
         void zoom_to_point ( const int& x, const int& y, const int& wsz );
 
         void mark( int x, int y, int thickness=-1 );
@@ -90,6 +124,10 @@ namespace kortex {
         void reset_display();
         void reset();
 
+        // the drawn display becomes the background restored by reset_display
+        void save_display();
+        void clear_display();
+
         void init_mouse();
         void reset_mouse();
         int wait( const int& ms ) const;
@@ -114,16 +152,32 @@ namespace kortex {
         int  w() const { return dw; }
         int  h() const { return dh; }
 
+        // bytes of the display buffers of this window. freed buffers kept
+        // for reuse by the shared pool are counted once per process by
+        // pool_memory_usage.
+        size_t memory_usage() const;
+        static size_t pool_memory_usage();
+
     private:
 
         void init_();
 
+        struct AsyncLoad;
+        AsyncLoad* async;
+        void cancel_load();
+
         IplImage* display;
         IplImage* original_display;
 
         string wname;
 
         int margin;
+        bool bheadless;
+
+        callback_info  local_mouse;   // mouse state of headless windows
+        callback_info* mouse;         // polled mouse state
+        InputSession*  session;
+        DisplayList*   dlist;
 
         int dh; // window size
         int dw;
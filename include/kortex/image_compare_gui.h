@@ -0,0 +1,84 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_IMAGE_COMPARE_GUI_H
+#define KORTEX_IMAGE_COMPARE_GUI_H
+
+#include "kortex/gui_window.h"
+#include "kortex/view_transform.h"
+
+#include <vector>
+#include <map>
+
+using std::vector;
+
+namespace kortex {
+
+    class Image;
+
+    enum CompareLayout { CL_SIDE_BY_SIDE=0, CL_FLICKER=1, CL_SPLIT=2, CL_DIFFERENCE=3 };
+
+    void compare( const vector<const Image*>& imgs, int w=0, int h=0, CompareLayout layout=CL_SIDE_BY_SIDE );
+
+    // ImageGUI counterpart for inspecting several images of the same size
+    // through one shared view transform
+    class ImageCompareGUI {
+    public:
+        ImageCompareGUI();
+        ~ImageCompareGUI();
+        void setup( const vector<const Image*>& images );
+        void create( int window_width, int window_height );
+        void display( double time_out=0.0 );
+        void set_layout( CompareLayout l );
+
+    private:
+        GUIWindow            wimg;
+        vector<const Image*> imgs;
+        ViewTransform        view;
+        CompareLayout        layout;
+        int                  gw, gh;   // window size
+        int                  mx, my;   // cursor in panel coordinates
+        int                  ia, ib;   // active pair: flicker / split / difference
+        int                  split_x;
+        int                  frame;
+        bool                 bflicker;
+        bool                 bdirty;
+        float                vmin, vmax;
+
+        // difference tiles of pair (dt_a,dt_b) at scale dt_scale, indexed by
+        // the tile position on the global display grid
+        std::map<long long, vector<uchar> > diff_tiles;
+        double               dt_scale;
+        int                  dt_a, dt_b;
+        IplImage*            tile_a;
+        IplImage*            tile_b;
+
+        int  no_panels() const;
+        int  panel_width() const;
+        void fit_view();
+
+        void render();
+        void render_region( const Image* im, int ox, int x, int w );
+        void render_difference();
+        const vector<uchar>& difference_tile( int tx, int ty );
+        void clear_difference_tiles();
+
+        void draw_overlays();
+        void reset_mouse();
+        void catch_mouse();
+        bool catch_keyboard();
+    };
+
+}
+
+#endif
@@ -15,10 +15,15 @@
 #define KORTEX_IMAGE_GUI_H
 
 #include "kortex/gui_window.h"
+#include "kortex/view_transform.h"
+#include "kortex/rect_tree.h"
+#include "kortex/colormap.h"
 
 namespace kortex {
 
     class Image;
+    class FeatureOverlay;
+    class FlowOverlay;
     void display( const Image* img, int w=0, bool interactive=true, double time_out_in_secs=0.0 );
 
     class ImageGUI {
@@ -29,21 +34,72 @@ namespace kortex {
         void create( int window_width );
         void display( double time_out=0.0 );
         void display_only( double time_out=0.0 );
+
+        void   set_features( const FeatureOverlay* fo ) { features = fo; }
+        // flow field of the image size, drawn under the features
+        void   set_flow( const FlowOverlay* fo ) { flow = fo; }
+
+        // regions of interest in image coordinates. only the ones in the
+        // viewport are drawn; hover and click are resolved through an r-tree.
+        // the vector must outlive the gui.
+        void   set_regions( const vector<Rect2f>* rects );
+        int    hovered_region() const { return hover_region; }
+        void   set_low_memory( bool lm ) { blow_memory = lm; }
+
+        // false color for single channel images, and a colormapped scalar
+        // field of the image size alpha-blended over the image (nan pixels
+        // of the field are transparent). 'c' cycles the colormap.
+        void   set_colormap( ColormapType cm ) { cmap = cm; }
+        void   set_overlay ( const Image* field, float alpha=0.5f, ColormapType cm=CMAP_TURBO );
+        size_t memory_usage() const;
+
+        // records the window input or replays a recorded log headless with
+        // per-frame timings. call before create().
+        void record_input( InputLog* log ) { wimg.record_input( log ); }
+        void replay_input( const InputLog* log, ReplayStats* stats ) { wimg.replay_input( log, stats ); }
+
+        // overlay and mouse coordinates: the display may be a downsampled
+        // version of the image
+        const ViewTransform& get_view() const { return view; }
+        void display_to_image( int dx, int dy, int& ix, int& iy ) const;
+        void image_to_display( float ix, float iy, int& dx, int& dy ) const;
     private:
         GUIWindow   wimg;
         GUIWindow*  wzoom;
+        ViewTransform view;
         bool        bhover;
         bool        benable_help;
         bool        benable_shadow;
-        int         gx, gy, gw, gh;
-        int         zsz;
+        bool        blow_memory;
+        int         gx, gy, gw, gh; // cursor in image coordinates, window size
+        int         zn;     // source pixels across the zoom window
+        int         zmag;   // magnification of the zoom window
+        int         zx, zy; // source pixel the zoom window is showing
+        float       vmin, vmax;
         const Image* imgp;
+        const Image* dimg;      // shown image: imgp or its colormapped copy
+        Image*       cimg;
+        ColormapType cmap;
+        const Image* overlay;
+        float        overlay_alpha;
+        ColormapType overlay_cmap;
+        const FeatureOverlay* features;
+        const FlowOverlay*    flow;
+        const vector<Rect2f>* regions;
+        RectTree    region_tree;
+        vector<int> region_hits;
+        int         hover_region;
 
+        void upload();
         void reset_display();
         void refresh();
         void display_help();
         void display_messages();
         void draw_mouse_shadow();
+        void draw_features();
+        void draw_flow();
+        void draw_regions();
+        int  region_at( int dx, int dy );
 
         void toggle_zoom_window();
         void update_zoom_window();
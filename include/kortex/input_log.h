@@ -0,0 +1,90 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_INPUT_LOG_H
+#define KORTEX_INPUT_LOG_H
+
+#include "kortex/gui_window.h"
+
+#include <vector>
+#include <string>
+#include <cstdio>
+
+using std::vector;
+using std::string;
+
+namespace kortex {
+
+    // input seen by a window at one wait() call. frames count the wait()
+    // calls since recording started; the mouse fields are the polled state.
+    struct InputEvent {
+        int    frame;
+        double time;  // seconds since recording started
+        int    key;
+        int    x, y;
+        int    event;
+    };
+
+    class InputLog {
+    public:
+        void clear() { events.clear(); }
+        void add( const InputEvent& e ) { events.push_back( e ); }
+        int  size() const { return (int)events.size(); }
+        const InputEvent& at( int i ) const { return events[i]; }
+
+        void save( const string& file ) const;
+        void load( const string& file );
+
+    private:
+        vector<InputEvent> events;
+    };
+
+    // frame times of a replay and the hash of the last shown frame
+    struct ReplayStats {
+        vector<double>     frame_ms;
+        unsigned long long frame_hash;
+
+        ReplayStats() { frame_hash = 0; }
+        double percentile( double p ) const;
+        void   print( FILE* fp=stdout ) const;
+    };
+
+    // records the input a window polls or feeds a recorded log back to it.
+    // a replay ignores the time stamps and runs at full speed. once the log
+    // is exhausted (or a 'q' is replayed) one more frame is drawn and hashed
+    // before 'q' is reported to end the display loop.
+    class InputSession {
+    public:
+        InputSession();
+
+        void record( InputLog* log );
+        void replay( const InputLog* log, ReplayStats* stats );
+
+        // called by the window at every wait() and refresh()
+        int  next_frame( int key, callback_info& mouse );
+        void frame_shown( const IplImage* display );
+
+    private:
+        InputLog*       rec_log;
+        const InputLog* rep_log;
+        ReplayStats*    rep_stats;
+        int             rep_pos;
+        int             rep_state;
+        int             frame;
+        double          t0, last;
+        callback_info   last_mouse;
+    };
+
+}
+
+#endif
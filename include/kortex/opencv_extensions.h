@@ -31,6 +31,8 @@ namespace kortex {
 
     class Color;
     class Image;
+    class Colormap;
+    struct ViewTransform;
 
     void draw_ray      ( IplImage* img, int x0,  int y0, float length, float angle, Color* color, int thickness=1);
     void draw_line     ( IplImage* img, int x0,  int y0, int x1, int y1, Color* color, int thickness=1);
@@ -39,18 +41,40 @@ namespace kortex {
     void draw_rectangle( IplImage* img, int x,   int y, int dw, int dh, Color* color, int thickness=1);
     void draw_polygon  ( IplImage* img, int* xy, int no_points, Color* color, int thickness=1 );
 
+    // open polylines of counts[i] points each, xy holding all the points
+    // back to back. drawn by one cvPolyLine call without anti-aliasing: the
+    // batch path for thousands of small shapes.
+    void draw_polylines( IplImage* img, const int* xy, const int* counts, int no_lines, Color* color, int thickness=1 );
+
     void write_on_image(IplImage* img, int x, int y, string text, Color* color, CvFont* display_font);
     void write_on_image_cv(Image* img, const vector<ImageTextInfo> &info );
 
     void overlay_region(IplImage* img, int* occmap);
 
+    // the IplImage*& versions reallocate the destination from buffer_pool()
+    // on a size change; release it with release_pooled_image.
     void copy_to_color_ipl(const IplImage* src, int x, int y, int w, IplImage* &dest);
 
     void copy_image_to_color_ipl(const uchar* im, int w, int h, int nc, IplImage* ipl );
     void copy_image_to_color_ipl(const Image* im, IplImage*& ipl );
+    void copy_image_to_ipl( const Image* im, float vmin, float vmax, IplImage* ipl );
+    void downsample_image_to_ipl( const Image* im, int factor, float vmin, float vmax, IplImage* ipl );
 
     void copy_ipl_to_image( const IplImage* ipl, Image *im );
 
+    // in place false color of a display made by downsample_image_to_ipl:
+    // the gray level of every pixel is mapped through cmap, or the field of
+    // the source size is sampled at the centre of each factor x factor block
+    // and blended over it (nan pixels are transparent). vmin >= vmax uses
+    // the range of the field.
+    void colormap_ipl( IplImage* ipl, const Colormap& cmap );
+    void blend_colormap_ipl( IplImage* ipl, int factor, const Image* field, const Colormap& cmap,
+                             float vmin, float vmax, float alpha );
+
+    void image_range( const Image* im, float& vmin, float& vmax );
+    void render_view( const Image* im, const ViewTransform& view, float vmin, float vmax,
+                      IplImage* dst, int px, int py, int pw, int ph );
+
     void write_on_image( Image* im, const vector<ImageTextInfo>& tinfo );
 
 }
@@ -15,17 +15,27 @@
 #define KORTEX_PLOT_H
 
 #include <vector>
+#include <string>
+#include <cstdint>
 #include "kortex/gui_window.h"
+#include "kortex/plot_stream.h"
 
 using std::vector;
+using std::string;
 
 namespace kortex {
 
-    enum PlotTypes { PT_DOT=1, PT_LINE=2, PT_STEM=4 };
+    enum PlotTypes { PT_DOT=1, PT_LINE=2, PT_STEM=4, PT_DENSITY=8 };
 
     void plot( vector<float>& xs, vector<float>& ys, int type = PT_DOT | PT_LINE );
     void plot( vector<float>& ys, int type = PT_DOT | PT_LINE );
 
+    class Plot;
+    class PlotFile;
+
+    // renders the plots headless into files, in parallel over the plots
+    void render_plots( const vector<Plot*>& plots, const vector<string>& files, int w=1024, int h=512 );
+
     struct PlotParams {
         float x_shift;
         float y_shift;
@@ -61,6 +71,90 @@ namespace kortex {
         }
     };
 
+    // native sample types of series buffers
+    enum PlotSampleType { PST_FLOAT, PST_DOUBLE, PST_INT16, PST_INT32, PST_INT64 };
+
+    template<typename T> struct PlotSampleTraits;
+    template<> struct PlotSampleTraits<float>   { enum { type = PST_FLOAT  }; };
+    template<> struct PlotSampleTraits<double>  { enum { type = PST_DOUBLE }; };
+    template<> struct PlotSampleTraits<int16_t> { enum { type = PST_INT16  }; };
+    template<> struct PlotSampleTraits<int32_t> { enum { type = PST_INT32  }; };
+    template<> struct PlotSampleTraits<int64_t> { enum { type = PST_INT64  }; };
+
+    // reads sample k of a native buffer relative to origin. integers are
+    // subtracted in their own type so that int64 time stamps keep full
+    // precision; origin is integral for integer buffers.
+    inline double plot_sample( const void* buf, int type, size_t k, double origin ) {
+        switch( type ) {
+        case PST_DOUBLE: return ((const double* )buf)[k] - origin;
+        case PST_INT16 : return ((const int16_t*)buf)[k] - origin;
+        case PST_INT32 : return double( ((const int32_t*)buf)[k] - (int64_t)origin );
+        case PST_INT64 : return double( ((const int64_t*)buf)[k] - (int64_t)origin );
+        default        : return ((const float*  )buf)[k] - origin;
+        }
+    }
+
+    // one data series of a plot. samples are read through a non-owning
+    // strided view (x may be omitted for index abscissae) or from the window
+    // of a PlotStream; the plot never copies them.
+    struct PlotSeries {
+        const void*  xs;
+        const void*  ys;
+        int          x_type;   // PlotSampleType
+        int          y_type;
+        int          n;
+        int          x_stride; // in elements
+        int          y_stride;
+        double       x_origin; // samples are plotted relative to the origin
+        double       y_origin;
+        PlotStream*  stream;
+        const PlotFile* file;  // out-of-core samples, drawn from its pyramid
+
+        Color        color;
+        int          ptype;
+        string       legend;
+
+        float        x_min, x_max;
+        float        y_min, y_max;
+        bool         bmonotone;
+        mutable vector<int> kd_index; // implicit 2d tree over the samples,
+        mutable bool        kd_valid; // built by the first search
+
+        // m4 decimated polyline of the visible x-range: first, min, max and
+        // last sample of each pixel column, valid for the view it was built for
+        vector<float> m4_x;
+        vector<float> m4_y;
+        PlotParams    m4_params;
+        int           m4_w, m4_h;
+        bool          m4_valid;
+
+        // color mapped 2d histogram of the samples over the plot area, valid
+        // for the view it was built for
+        vector<uchar> dens_rgb;
+        vector<uchar> dens_mask;
+        PlotParams    dens_params;
+        int           dens_w, dens_h;
+        bool          dens_valid;
+
+        PlotSeries();
+
+        int   size() const { return stream ? stream->size() : n; }
+        float x( int i ) const {
+            if( stream ) return stream->x(i);
+            if( !xs    ) return float( i - x_origin );
+            return (float)plot_sample( xs, x_type, (size_t)i*x_stride, x_origin );
+        }
+        float y( int i ) const {
+            if( stream ) return stream->y(i);
+            return (float)plot_sample( ys, y_type, (size_t)i*y_stride, y_origin );
+        }
+
+        int  lower_sample( float rx ) const;
+        int  upper_sample( float rx ) const;
+        void update_bounds();
+        void build_index() const;
+    };
+
     class Plot {
     public:
         Plot();
@@ -68,14 +162,75 @@ namespace kortex {
         void set_params( PlotParams& gparams );
         void create( int w, int h );
         void display();
+
+        // draws the plot without a window
+        void render( int w, int h, Image* out );
+        void render( int w, int h, const string& file );
+
+        // records the input of the interactive window or replays a recorded
+        // log headless with per-frame timings. call before create().
+        void record_input( InputLog* log ) { wmain.record_input( log ); }
+        void replay_input( const InputLog* log, ReplayStats* stats ) { wmain.replay_input( log, stats ); }
+
         void shift_x( float xs );
         void shift_y( float ys );
         void zoom   ( float zf );
         void center_coordinate( float tx, float ty );
 
+        // copies the samples into the plot and makes them its only series
         void set( const vector<float>& ys );
         void set( const vector<float>& xs, const vector<float>& ys );
-        void set_type( int pt ) { params.ptype = pt; }
+        void set_type( int pt );
+
+        // zero-copy series on shared axes read in their native sample type
+        // (float, double, int16_t, int32_t, int64_t). the buffers must outlive
+        // the plot.
+        template<typename TY>
+        int  add_series( const TY* ys, int n, int stride=1, const string& legend="" ) {
+            PlotSeries s;
+            s.ys       = ys;
+            s.y_type   = PlotSampleTraits<TY>::type;
+            s.n        = n;
+            s.y_stride = stride;
+            s.legend   = legend;
+            return add_series( s );
+        }
+        template<typename TX, typename TY>
+        int  add_series( const TX* xs, const TY* ys, int n, int x_stride=1, int y_stride=1, const string& legend="" ) {
+            PlotSeries s;
+            s.xs       = xs;
+            s.ys       = ys;
+            s.x_type   = PlotSampleTraits<TX>::type;
+            s.y_type   = PlotSampleTraits<TY>::type;
+            s.n        = n;
+            s.x_stride = x_stride;
+            s.y_stride = y_stride;
+            s.legend   = legend;
+            return add_series( s );
+        }
+        void set_series_color( int sid, const Color& col );
+        void set_series_type ( int sid, int pt );
+        void clear_series();
+        int  no_series() const { return (int)series.size(); }
+
+        // data coordinates are drawn relative to the origin so that values
+        // far from zero (e.g. time stamps) keep their precision. the first
+        // series sets it unless it is given explicitly, and it follows the
+        // view when the view is moved far from it.
+        void set_origin( double x0, double y0 );
+
+        // out-of-core series of a mapped sample file over the sample index
+        int  add_series( const PlotFile* pf, const string& legend="" );
+
+        // live mode: draws the window of a PlotStream fed by another thread
+        void set_stream( PlotStream* ps );
+
+        // nearest sample of series sid to the data point (x,y) in the screen
+        // distance of the last drawn view
+        int  closest_sample( int sid, double x, double y ) const;
+
+        // window coordinates of the data point (x,y) in the last drawn view
+        void data_to_screen( double x, double y, float& gx, float& gy ) const;
 
     private:
         PlotParams params;
@@ -92,11 +247,18 @@ namespace kortex {
 
         void draw_mouse_shadow();
         void draw_grid();
-        void draw_points();
-        void draw_line();
+        void draw_points( PlotSeries& s );
+        void draw_line  ( PlotSeries& s );
+        void draw_stems ( PlotSeries& s );
+        void draw_density( PlotSeries& s );
+        void draw_file   ( const PlotSeries& s );
+        void draw_legend();
         void draw_data();
 
         void redraw();
+        void update_grid();
+        void init_view();
+        void create_headless( int w, int h );
 
         void find_shift_to_center( float tx, float ty, float& xs, float& ys ) const;
 
@@ -108,6 +270,14 @@ namespace kortex {
         void rxy_to_cxy( float rx, float ry, float& cx, float& cy ) const;
         void cxy_to_rxy( float cx, float cy, float& rx, float& ry ) const;
 
+        // batch versions over structure-of-arrays points. the clip codes flag
+        // points left, right, above and below the plot area (bits 0-3).
+        void rxy_to_gxy( const float* rx, const float* ry, int n, float* gx, float* gy ) const;
+        void clip_codes( const float* gx, const float* gy, int n, uchar* codes ) const;
+        int  gather_samples( const PlotSeries& s, int i0, int n, float* rx, float* ry ) const;
+        void draw_segments( const float* gx, const float* gy, const uchar* codes, int n );
+        void update_transform();
+
         bool is_visible( float gx, float gy ) const;
         bool is_visible_x( float gx ) const;
         bool is_visible_y( float gy ) const;
@@ -115,10 +285,45 @@ namespace kortex {
         float x_range() const;
         float y_range() const;
 
-        int find_closest( float rx, float ry ) const;
+        bool has_samples() const;
+        int  find_closest( float rx, float ry, int& sid ) const;
+        int  find_closest( const PlotSeries& s, float rx, float ry, float& dist ) const;
+        int  find_closest_linear( const PlotSeries& s, float rx, float ry ) const;
+        void search_index( const PlotSeries& s, int lo, int hi, int depth, float rx, float ry, double sx, double sy,
+                           float tx, float ty, int& id, float& dist ) const;
+        void test_closest( const PlotSeries& s, int i, float tx, float ty, int& id, float& dist ) const;
+
+        int  add_series( const PlotSeries& s );
+        void pick_origin( const PlotSeries& s );
+        void apply_origin( PlotSeries& s ) const;
+        void update_origins();
+        void rebase_origin();
+        void update_bounds();
+        void update_stream();
+
+        void decimate_line( PlotSeries& s );
+        bool is_decimation_valid( const PlotSeries& s ) const;
+        bool is_view_equal( const PlotParams& p, int w, int h ) const;
+        void build_density( PlotSeries& s );
+
+        vector<float>      xvals; // storage of set()
+        vector<float>      yvals;
+        vector<PlotSeries> series;
+        PlotStream*        stream;
+        bool               bscroll;
+        bool               bview;
+        double             x_origin, y_origin;
+        bool               borigin;
+
+        // affine view transform, recomputed whenever the view changes
+        float              tsx, tsy; // data units per plot pixel
+        float              tix, tiy; // plot pixels per data unit
 
-        vector<float> xvals;
-        vector<float> yvals;
+        // the axes, grid and tick labels are kept in the background of wmain
+        // and redrawn only when the view changes
+        PlotParams         grid_params;
+        int                grid_w, grid_h;
+        bool               grid_valid;
     };
 
 }
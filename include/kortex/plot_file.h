@@ -0,0 +1,81 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_PLOT_FILE_H
+#define KORTEX_PLOT_FILE_H
+
+#include "kortex/plot.h"
+#include <string>
+#include <cstddef>
+
+using std::string;
+
+namespace kortex {
+
+    // out-of-core source for plots of raw sample files. the file is memory
+    // mapped and never read as a whole after the first open: a min/max
+    // pyramid over blocks of samples is kept in a sidecar file (file.pyr)
+    // which is built once and reused while the sample file is unchanged.
+    // level l holds the min and max of blocks of block_size(l) samples.
+    class PlotFile {
+    public:
+        PlotFile();
+        ~PlotFile();
+
+        void open( const string& file, int sample_type=PST_FLOAT );
+        void close();
+        bool is_open() const { return data != NULL; }
+
+        size_t size() const { return n; }
+        float  sample( size_t i ) const {
+            return (float)plot_sample( data, type, i, 0.0 );
+        }
+
+        int    no_levels() const { return nlevels; }
+        size_t block_size( int l ) const { return (size_t)base << l; }
+        size_t level_size( int l ) const;
+        const float* level( int l ) const; // interleaved min, max per block
+
+        // coarsest level whose blocks are not wider than spp samples, -1 if
+        // the raw samples are finer
+        int    level_for( double spp ) const;
+
+        float  y_min() const { return vmin_all; }
+        float  y_max() const { return vmax_all; }
+
+    private:
+        void build_pyramid( const string& pfile, long long src_size, long long src_mtime );
+        bool map_pyramid  ( const string& pfile, long long src_size, long long src_mtime );
+        void set_levels();
+
+        int    fd;
+        void*  data;
+        size_t data_bytes;
+        int    type;
+        size_t n;
+
+        void*  pyr;
+        size_t pyr_bytes;
+        int    base;
+        int    nlevels;
+        vector<size_t> loffset;    // float offset of each level in the sidecar
+
+        float  vmin_all, vmax_all;
+
+        PlotFile( const PlotFile& );
+        PlotFile& operator=( const PlotFile& );
+    };
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_PLOT_STREAM_H
+#define KORTEX_PLOT_STREAM_H
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <cstddef>
+
+using std::vector;
+
+namespace kortex {
+
+    // single producer / single consumer sample ring for live plots.
+    //
+    // one producer thread calls push() which never blocks: samples that do
+    // not fit are dropped and counted. the plot thread calls update() which
+    // publishes the newest window samples in place (the history is never
+    // copied) and keeps the y bounds of the window with monotonic deques.
+    // x is expected to be non-decreasing (e.g. time stamps).
+    class PlotStream {
+    public:
+        PlotStream( int window_size, int burst_size=1<<20 );
+
+        // producer side
+        int    push( float x, float y );
+        int    push( const float* xs, const float* ys, int n );
+        size_t dropped() const { return ndropped.load(); }
+
+        // consumer side. indices run from the oldest (0) to the newest
+        // (size()-1) sample of the window published by the last update().
+        void  update();
+        int   size() const { return int( wend-wstart ); }
+        float x( int i ) const { return xbuf[ (wstart+i) & mask ]; }
+        float y( int i ) const { return ybuf[ (wstart+i) & mask ]; }
+        float y_min() const;
+        float y_max() const;
+
+    private:
+        int           window;
+        size_t        mask;
+        vector<float> xbuf;
+        vector<float> ybuf;
+
+        std::atomic<size_t> head;     // next sequence number the producer writes
+        std::atomic<size_t> tail;     // oldest sequence number the consumer uses
+        std::atomic<size_t> ndropped;
+
+        size_t wstart, wend;          // published window [wstart,wend)
+        size_t seen;                  // samples folded into the deques
+        std::deque<size_t> dmin, dmax;
+
+        PlotStream( const PlotStream& );
+        PlotStream& operator=( const PlotStream& );
+    };
+
+}
+
+#endif
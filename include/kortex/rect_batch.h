@@ -0,0 +1,55 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_RECT_BATCH_H
+#define KORTEX_RECT_BATCH_H
+
+#include <kortex/rect2.h>
+#include <kortex/types.h>
+#include <vector>
+
+using std::vector;
+
+namespace kortex {
+
+    // batch versions of Rect2f/Rect2i::is_inside with the same half-open
+    // bounds [lx,ux) x [ly,uy). mask[i] is 1 for points inside, 0 otherwise.
+    void is_inside( const Rect2f& r, const float* xs, const float* ys, int n, uchar* mask );
+    void is_inside( const Rect2i& r, const int*   xs, const int*   ys, int n, uchar* mask );
+
+    // one point / one query rect against n rects given as structure of
+    // arrays. the indices of the hits are written to ids in increasing
+    // order, the number of hits is returned.
+    int rects_containing ( const float* lx, const float* ly, const float* ux, const float* uy, int n,
+                           float x, float y, int* ids );
+    int rects_overlapping( const float* lx, const float* ly, const float* ux, const float* uy, int n,
+                           const Rect2f& q, int* ids );
+
+    // rects kept as structure of arrays for the batch queries
+    class RectSet {
+    public:
+        void clear();
+        void add( const Rect2f& r );
+        int  size() const { return (int)lx.size(); }
+        Rect2f rect( int i ) const;
+
+        int  containing ( float x, float y, int* ids ) const;
+        int  overlapping( const Rect2f& q,  int* ids ) const;
+
+    private:
+        vector<float> lx, ly, ux, uy;
+    };
+
+}
+
+#endif
@@ -0,0 +1,55 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_RECT_TREE_H
+#define KORTEX_RECT_TREE_H
+
+#include <kortex/rect2.h>
+#include <vector>
+
+using std::vector;
+
+namespace kortex {
+
+    // static r-tree over rectangles for hit-testing and viewport culling.
+    // the tree is bulk loaded with sort-tile-recursive packing; the boxes
+    // of every level are stored as structure of arrays so that the children
+    // of a node are tested with the batch kernels of rect_batch.h.
+    class RectTree {
+    public:
+        RectTree();
+
+        void build( const vector<Rect2f>& rects, int fanout=16 );
+        void clear();
+        int  size() const { return (int)order.size(); }
+
+        // indices of the rects containing the point / overlapping q, sorted
+        void query_point( float x, float y, vector<int>& ids ) const;
+        void query_rect ( const Rect2f& q,  vector<int>& ids ) const;
+
+    private:
+        struct Level {
+            vector<float> lx, ly, ux, uy;
+            vector<int>   first;   // first child of each node in the level below
+        };
+        vector<Level> levels;      // levels[0] holds the rects in tree order
+        vector<int>   order;       // tree order -> rect index
+        int           fanout;
+
+        void query_point( int l, int i0, int i1, float x, float y, vector<int>& ids ) const;
+        void query_rect ( int l, int i0, int i1, const Rect2f& q,  vector<int>& ids ) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,47 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifndef KORTEX_VIEW_TRANSFORM_H
+#define KORTEX_VIEW_TRANSFORM_H
+
+namespace kortex {
+
+    // maps display pixels to image coordinates as ix = x0 + dx * scale
+    struct ViewTransform {
+        double scale; // image pixels per display pixel
+        double x0;    // image coordinate of the display origin
+        double y0;
+
+        ViewTransform() {
+            scale = 1.0;
+            x0    = 0.0;
+            y0    = 0.0;
+        }
+
+        void fit ( int iw, int ih, int dw, int dh );
+        void zoom( double dx, double dy, double zf );
+        void pan ( double ddx, double ddy );
+        void snap();
+
+        void display_to_image( double dx, double dy, double& ix, double& iy ) const;
+        void image_to_display( double ix, double iy, double& dx, double& dy ) const;
+
+        void visible_region( int dw, int dh, double& ix0, double& iy0, double& ix1, double& iy1 ) const;
+
+        bool operator==( const ViewTransform& v ) const;
+        bool operator!=( const ViewTransform& v ) const { return !( *this == v ); }
+    };
+
+}
+
+#endif
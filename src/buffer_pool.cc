@@ -0,0 +1,171 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/buffer_pool.h"
+#include <kortex/check.h>
+
+#ifdef WITH_OPENCV
+#include <opencv2/opencv.hpp>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+
+namespace kortex {
+
+    namespace {
+        const int    min_class_log = 12;                  // 4 kb
+        const size_t alignment     = 64;
+
+        // class index and rounded size: bytes in (2^k, 2^(k+1)] fall into
+        // one of four classes of 2^(k-2) bytes each
+        int size_class( size_t bytes, size_t& csize ) {
+            size_t lo = size_t(1) << min_class_log;
+            if( bytes <= lo ) {
+                csize = lo;
+                return 0;
+            }
+            int k = min_class_log;
+            while( ( size_t(1) << (k+1) ) < bytes )
+                k++;
+            size_t base = size_t(1) << k;
+            size_t q    = base >> 2;
+            size_t sub  = ( bytes - base + q-1 ) / q;
+            csize = base + sub*q;
+            return 4*( k-min_class_log ) + (int)sub;
+        }
+
+        size_t class_bytes( int c ) {
+            if( c == 0 ) return size_t(1) << min_class_log;
+            size_t base = size_t(1) << ( min_class_log + (c-1)/4 );
+            return base + ( (c-1)%4 + 1 ) * ( base >> 2 );
+        }
+    }
+
+    void BufferPoolStats::print( FILE* fp ) const {
+        fprintf( fp, "buffer pool: hits %zu misses %zu (hit rate %.3f) dropped %zu held %.1f mb out %.1f mb\n",
+                 hits, misses, hit_rate(), dropped, bytes_held/1048576.0, bytes_out/1048576.0 );
+    }
+
+    BufferPool::BufferPool( size_t capacity_in_bytes ) {
+        capacity = capacity_in_bytes;
+        memset( &st, 0, sizeof(st) );
+    }
+
+    BufferPool::~BufferPool() {
+        trim();
+    }
+
+    size_t BufferPool::class_size( size_t bytes ) {
+        size_t csize;
+        size_class( bytes, csize );
+        return csize;
+    }
+
+    void* BufferPool::acquire( size_t bytes ) {
+        size_t csize;
+        int c = size_class( bytes, csize );
+        {
+            std::lock_guard<std::mutex> lock( mtx );
+            st.bytes_out += csize;
+            if( c < (int)free_lists.size() && !free_lists[c].empty() ) {
+                void* p = free_lists[c].back();
+                free_lists[c].pop_back();
+                st.bytes_held -= csize;
+                st.hits++;
+                return p;
+            }
+            st.misses++;
+        }
+        void* p = NULL;
+        passert_statement( posix_memalign( &p, alignment, csize ) == 0, "out of memory" );
+        return p;
+    }
+
+    void BufferPool::release( void* p, size_t bytes ) {
+        if( !p ) return;
+        size_t csize;
+        int c = size_class( bytes, csize );
+        {
+            std::lock_guard<std::mutex> lock( mtx );
+            st.bytes_out -= csize;
+            if( st.bytes_held + csize <= capacity ) {
+                if( c >= (int)free_lists.size() ) free_lists.resize( c+1 );
+                free_lists[c].push_back( p );
+                st.bytes_held += csize;
+                return;
+            }
+            st.dropped++;
+        }
+        free( p );
+    }
+
+    void BufferPool::set_capacity( size_t bytes ) {
+        std::lock_guard<std::mutex> lock( mtx );
+        capacity = bytes;
+        trim_to( capacity );
+    }
+
+    void BufferPool::trim() {
+        std::lock_guard<std::mutex> lock( mtx );
+        trim_to( 0 );
+    }
+
+    // frees the largest classes first, they are the least likely to be hit
+    void BufferPool::trim_to( size_t bytes ) {
+        for( int c=(int)free_lists.size()-1; c>=0 && st.bytes_held > bytes; c-- ) {
+            size_t csize = class_bytes( c );
+            while( !free_lists[c].empty() && st.bytes_held > bytes ) {
+                free( free_lists[c].back() );
+                free_lists[c].pop_back();
+                st.bytes_held -= csize;
+            }
+        }
+    }
+
+    BufferPoolStats BufferPool::stats() const {
+        std::lock_guard<std::mutex> lock( mtx );
+        return st;
+    }
+
+    BufferPool& buffer_pool() {
+        static BufferPool pool;
+        return pool;
+    }
+
+#ifdef WITH_OPENCV
+
+    // pooled images carry their pixels in imageData only: imageDataOrigin
+    // stays NULL so that cvReleaseImage never frees pool memory.
+    IplImage* create_pooled_image( int w, int h, int nc ) {
+        IplImage* ipl = cvCreateImageHeader( cvSize(w,h), IPL_DEPTH_8U, nc );
+        size_t bytes = (size_t)ipl->widthStep * h;
+        cvSetData( ipl, buffer_pool().acquire( bytes ), ipl->widthStep );
+        ipl->imageDataOrigin = NULL;
+        return ipl;
+    }
+
+    void release_pooled_image( IplImage** ipl ) {
+        assert_pointer( ipl );
+        if( !*ipl ) return;
+        if( (*ipl)->imageDataOrigin == NULL && (*ipl)->imageData ) {
+            buffer_pool().release( (*ipl)->imageData, (size_t)(*ipl)->widthStep * (*ipl)->height );
+            cvReleaseImageHeader( ipl );
+        } else {
+            cvReleaseImage( ipl );
+        }
+    }
+
+#endif
+
+}
@@ -0,0 +1,335 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/colormap.h"
+#include <kortex/image.h>
+#include <kortex/check.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef WITH_SSE
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace kortex {
+
+    namespace {
+        float clamp01( float v ) { return std::min( 1.0f, std::max( 0.0f, v ) ); }
+
+        // polynomial fits of the matplotlib viridis and google turbo maps
+        void viridis( float t, float* c ) {
+            static const float k[7][3] = {
+                {  0.2777273272234177f,  0.005407344544966578f,  0.3340998053353061f  },
+                {  0.1050930431085774f,  1.404613529898575f,     1.384590162594685f   },
+                { -0.3308618287255563f,  0.214847559468213f,     0.09509516302823659f },
+                { -4.634230498983486f,  -5.799100973351585f,   -19.33244095627987f    },
+                {  6.228269936347081f,  14.17993336680509f,     56.69055260068105f    },
+                {  4.776384997670288f, -13.74514537774601f,    -65.35303263337234f    },
+                { -5.435455855934631f,   4.645852612178535f,    26.3124352495832f     } };
+            for( int j=0; j<3; j++ ) {
+                float v = k[6][j];
+                for( int i=5; i>=0; i-- ) v = v*t + k[i][j];
+                c[j] = v;
+            }
+        }
+
+        void turbo( float t, float* c ) {
+            static const float k[6][3] = {
+                {   0.13572138f,   0.09140261f,   0.10667330f },
+                {   4.61539260f,   2.19418839f,  12.64194608f },
+                { -42.66032258f,   4.84296658f, -60.58204836f },
+                { 132.13108234f, -14.18503333f, 110.36276771f },
+                {-152.94239396f,   4.27729857f, -89.90310912f },
+                {  59.28637943f,   2.82956604f,  27.34824973f } };
+            for( int j=0; j<3; j++ ) {
+                float v = k[5][j];
+                for( int i=4; i>=0; i-- ) v = v*t + k[i][j];
+                c[j] = v;
+            }
+        }
+
+        // blue - light gray - red
+        void diverging( float t, float* c ) {
+            static const float lo[3] = { 0.230f, 0.299f, 0.754f };
+            static const float md[3] = { 0.865f, 0.865f, 0.865f };
+            static const float hi[3] = { 0.706f, 0.016f, 0.150f };
+            for( int j=0; j<3; j++ ) {
+                if( t < 0.5f ) c[j] = lo[j] + (md[j]-lo[j])*2*t;
+                else           c[j] = md[j] + (hi[j]-md[j])*(2*t-1);
+            }
+        }
+
+        void color_at( ColormapType type, float t, float* c ) {
+            switch( type ) {
+            case CMAP_JET:
+                c[0] = 1.5f - fabs( 4*t-3 );
+                c[1] = 1.5f - fabs( 4*t-2 );
+                c[2] = 1.5f - fabs( 4*t-1 );
+                break;
+            case CMAP_VIRIDIS:   viridis  ( t, c ); break;
+            case CMAP_TURBO:     turbo    ( t, c ); break;
+            case CMAP_DIVERGING: diverging( t, c ); break;
+            default:
+                c[0] = c[1] = c[2] = t;
+            }
+        }
+
+        // lut index scale: nans and values below vmin -> 0, above vmax ->
+        // size-1
+        inline float index_scale( float vmin, float vmax, int size ) {
+            return ( vmax > vmin ) ? (size-1)/(vmax-vmin) : 0.0f;
+        }
+
+        inline int lut_index( float v, float vmin, float s, int last ) {
+            float f = (v-vmin)*s + 0.5f;
+            if( !( f > 0.0f ) ) return 0;    // also nan
+            return std::min( last, (int)f );
+        }
+
+    }
+
+    void colormap_range( const Image* im, float& vmin, float& vmax ) {
+        assert_pointer( im );
+        int w = im->w(), h = im->h();
+        float lo =  1e30f;
+        float hi = -1e30f;
+        bool  is_float = ( im->precision() != TYPE_UCHAR );
+#pragma omp parallel
+        {
+            float tlo = 1e30f, thi = -1e30f;
+#pragma omp for
+            for( int y=0; y<h; y++ ) {
+                if( is_float ) {
+                    const float* row = im->get_row_f(y);
+                    for( int x=0; x<w; x++ ) {
+                        if( row[x] != row[x] ) continue;
+                        tlo = std::min( tlo, row[x] );
+                        thi = std::max( thi, row[x] );
+                    }
+                } else {
+                    const uchar* row = im->get_row_u(y);
+                    for( int x=0; x<w; x++ ) {
+                        tlo = std::min( tlo, (float)row[x] );
+                        thi = std::max( thi, (float)row[x] );
+                    }
+                }
+            }
+#pragma omp critical
+            {
+                lo = std::min( lo, tlo );
+                hi = std::max( hi, thi );
+            }
+        }
+        if( lo > hi ) { lo = 0.0f; hi = 1.0f; }
+        vmin = lo;
+        vmax = hi;
+    }
+
+    const char* colormap_name( ColormapType type ) {
+        switch( type ) {
+        case CMAP_GRAY:      return "gray";
+        case CMAP_JET:       return "jet";
+        case CMAP_VIRIDIS:   return "viridis";
+        case CMAP_TURBO:     return "turbo";
+        case CMAP_DIVERGING: return "diverging";
+        default:             return "unknown";
+        }
+    }
+
+    Colormap::Colormap( ColormapType type, int size ) {
+        set( type, size );
+    }
+
+    void Colormap::set( ColormapType type, int size ) {
+        passert_statement( size == 256 || size == 4096, "colormap size must be 256 or 4096" );
+        passert_statement( type >= CMAP_GRAY && type < CMAP_COUNT, "invalid colormap" );
+        ctype = type;
+        rgbx.resize( size );
+        bgrx.resize( size );
+        for( int i=0; i<size; i++ ) {
+            float c[3];
+            color_at( type, i/float(size-1), c );
+            uint32_t r = (uint32_t)( 255*clamp01( c[0] ) + 0.5f );
+            uint32_t g = (uint32_t)( 255*clamp01( c[1] ) + 0.5f );
+            uint32_t b = (uint32_t)( 255*clamp01( c[2] ) + 0.5f );
+            rgbx[i] = r | g<<8 | b<<16;
+            bgrx[i] = b | g<<8 | r<<16;
+        }
+    }
+
+    void Colormap::get( int i, uchar& r, uchar& g, uchar& b ) const {
+        uint32_t c = rgbx[ std::min( size()-1, std::max( 0, i ) ) ];
+        r = c & 0xff;
+        g = ( c >> 8  ) & 0xff;
+        b = ( c >> 16 ) & 0xff;
+    }
+
+    void Colormap::map_row( const float* src, int n, float vmin, float vmax, uchar* dst, bool bgr ) const {
+        const uint32_t* lut  = bgr ? &bgrx[0] : &rgbx[0];
+        int             last = size()-1;
+        float           s    = index_scale( vmin, vmax, size() );
+        int i = 0;
+#if defined(__AVX2__)
+        // 8 gathers per step, then the 4 byte pixels of each 128 bit lane are
+        // packed to 12 bytes. both lanes are stored with 16 byte writes, so
+        // the loop stops early enough to stay inside dst.
+        __m256  vmn  = _mm256_set1_ps( vmin );
+        __m256  vs   = _mm256_set1_ps( s );
+        __m256  half = _mm256_set1_ps( 0.5f );
+        __m256  zero = _mm256_setzero_ps();
+        __m256  top  = _mm256_set1_ps( (float)last );
+        __m256i pack = _mm256_setr_epi8( 0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1,
+                                         0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1 );
+        for( ; i+10<=n; i+=8 ) {
+            __m256 f = _mm256_add_ps( _mm256_mul_ps( _mm256_sub_ps( _mm256_loadu_ps( src+i ), vmn ), vs ), half );
+            f = _mm256_min_ps( _mm256_max_ps( f, zero ), top );
+            __m256i px = _mm256_i32gather_epi32( (const int*)lut, _mm256_cvttps_epi32( f ), 4 );
+            px = _mm256_shuffle_epi8( px, pack );
+            _mm_storeu_si128( (__m128i*)( dst+3*i    ), _mm256_castsi256_si128( px ) );
+            _mm_storeu_si128( (__m128i*)( dst+3*i+12 ), _mm256_extracti128_si256( px, 1 ) );
+        }
+#elif defined(WITH_SSE)
+        __m128 vmn  = _mm_set1_ps( vmin );
+        __m128 vs   = _mm_set1_ps( s );
+        __m128 half = _mm_set1_ps( 0.5f );
+        __m128 zero = _mm_setzero_ps();
+        __m128 top  = _mm_set1_ps( (float)last );
+        int      idx[4];
+        uint32_t px[4];
+        for( ; i+4<=n; i+=4 ) {
+            __m128 f = _mm_add_ps( _mm_mul_ps( _mm_sub_ps( _mm_loadu_ps( src+i ), vmn ), vs ), half );
+            // max( f, 0 ) returns 0 for nans
+            f = _mm_min_ps( _mm_max_ps( f, zero ), top );
+            _mm_storeu_si128( (__m128i*)idx, _mm_cvttps_epi32( f ) );
+            px[0] = lut[idx[0]]; px[1] = lut[idx[1]];
+            px[2] = lut[idx[2]]; px[3] = lut[idx[3]];
+            // 4 byte stores whose last byte the next pixel overwrites
+            for( int k=0; k<4; k++ )
+                memcpy( dst+3*(i+k), px+k, ( i+k+1 < n ) ? 4 : 3 );
+        }
+#endif
+        for( ; i<n; i++ )
+            memcpy( dst+3*i, lut + lut_index( src[i], vmin, s, last ), 3 );
+    }
+
+    // 8 bit values go through a 256 entry table of packed pixels built for
+    // the given range
+    void Colormap::map_row( const uchar* src, int n, float vmin, float vmax, uchar* dst, bool bgr ) const {
+        const uint32_t* lut  = bgr ? &bgrx[0] : &rgbx[0];
+        int             last = size()-1;
+        float           s    = index_scale( vmin, vmax, size() );
+        uint32_t        table[256];
+        for( int v=0; v<256; v++ )
+            table[v] = lut[ lut_index( (float)v, vmin, s, last ) ];
+
+        int i = 0;
+        for( ; i+1<n; i++ )
+            memcpy( dst+3*i, table + src[i], 4 );
+        if( i < n )
+            memcpy( dst+3*i, table + src[i], 3 );
+    }
+
+    void blend_row( const uchar* base, const uchar* over, int nbytes, float alpha, uchar* dst ) {
+        int a  = (int)( 256*std::min( 1.0f, std::max( 0.0f, alpha ) ) + 0.5f );
+        int ia = 256-a;
+        int i  = 0;
+#ifdef WITH_SSE
+        __m128i va   = _mm_set1_epi16( (short)a  );
+        __m128i via  = _mm_set1_epi16( (short)ia );
+        __m128i rnd  = _mm_set1_epi16( 128 );
+        __m128i zero = _mm_setzero_si128();
+        for( ; i+16<=nbytes; i+=16 ) {
+            __m128i b = _mm_loadu_si128( (const __m128i*)( base+i ) );
+            __m128i o = _mm_loadu_si128( (const __m128i*)( over+i ) );
+            // at most 255*256+128, fits in unsigned 16 bits
+            __m128i lo = _mm_add_epi16( _mm_mullo_epi16( _mm_unpacklo_epi8( b, zero ), via ),
+                                        _mm_mullo_epi16( _mm_unpacklo_epi8( o, zero ), va  ) );
+            __m128i hi = _mm_add_epi16( _mm_mullo_epi16( _mm_unpackhi_epi8( b, zero ), via ),
+                                        _mm_mullo_epi16( _mm_unpackhi_epi8( o, zero ), va  ) );
+            lo = _mm_srli_epi16( _mm_add_epi16( lo, rnd ), 8 );
+            hi = _mm_srli_epi16( _mm_add_epi16( hi, rnd ), 8 );
+            _mm_storeu_si128( (__m128i*)( dst+i ), _mm_packus_epi16( lo, hi ) );
+        }
+#endif
+        for( ; i<nbytes; i++ )
+            dst[i] = (uchar)( ( base[i]*ia + over[i]*a + 128 ) >> 8 );
+    }
+
+    void colormap_image( const Image* im, const Colormap& cmap, float vmin, float vmax, Image* out ) {
+        assert_pointer( im && out );
+        im->passert_type( IT_U_GRAY | IT_F_GRAY );
+        passert_statement( im != out, "in place colormapping is not supported" );
+
+        int w = im->w();
+        int h = im->h();
+        if( vmin >= vmax ) colormap_range( im, vmin, vmax );
+        out->create( w, h, IT_U_PRGB );
+
+        bool is_float = ( im->precision() != TYPE_UCHAR );
+#pragma omp parallel for
+        for( int y=0; y<h; y++ ) {
+            if( is_float ) cmap.map_row( im->get_row_f(y), w, vmin, vmax, out->get_row_u(y) );
+            else           cmap.map_row( im->get_row_u(y), w, vmin, vmax, out->get_row_u(y) );
+        }
+    }
+
+    void blend_colormap( const Image* base, const Image* field, const Colormap& cmap,
+                         float vmin, float vmax, float alpha, Image* out ) {
+        assert_pointer( base && field && out );
+        base ->passert_type( IT_U_PRGB | IT_U_GRAY );
+        field->passert_type( IT_U_GRAY | IT_F_GRAY );
+        passert_statement( base->w() == field->w() && base->h() == field->h(), "dimension mismatch" );
+        passert_statement( out != field, "in place blending into the field is not supported" );
+
+        int w = base->w();
+        int h = base->h();
+        if( vmin >= vmax ) colormap_range( field, vmin, vmax );
+        if( out != base ) out->create( w, h, IT_U_PRGB );
+        else              passert_statement( base->ch() == 3, "in place blending needs a color base" );
+
+        bool is_float = ( field->precision() != TYPE_UCHAR );
+        bool is_gray  = ( base->ch() == 1 );
+#pragma omp parallel
+        {
+            vector<uchar> over( 3*w );
+            vector<uchar> gray( is_gray ? 3*w : 0 );
+#pragma omp for
+            for( int y=0; y<h; y++ ) {
+                const uchar* brow = base->get_row_u(y);
+                if( is_gray ) {
+                    for( int x=0; x<w; x++ )
+                        gray[3*x] = gray[3*x+1] = gray[3*x+2] = brow[x];
+                    brow = &gray[0];
+                }
+                if( is_float ) {
+                    const float* frow = field->get_row_f(y);
+                    cmap.map_row( frow, w, vmin, vmax, &over[0] );
+                    // holes of the field show the base
+                    for( int x=0; x<w; x++ ) {
+                        if( frow[x] == frow[x] ) continue;
+                        over[3*x] = brow[3*x]; over[3*x+1] = brow[3*x+1]; over[3*x+2] = brow[3*x+2];
+                    }
+                } else {
+                    cmap.map_row( field->get_row_u(y), w, vmin, vmax, &over[0] );
+                }
+                blend_row( brow, &over[0], 3*w, alpha, out->get_row_u(y) );
+            }
+        }
+    }
+
+}
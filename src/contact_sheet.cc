@@ -0,0 +1,488 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/contact_sheet.h"
+#include "kortex/image_gui.h"
+#include <kortex/image.h>
+#include <kortex/check.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdint.h>
+#include <sys/stat.h>
+
+namespace kortex {
+
+    namespace {
+        const int cell_pad     = 8;
+        const int label_height = 14;
+
+        // area average of an 8 bit image (1 or 3 channels) down to fit into
+        // ts x ts, rgb out
+        void downscale( const Image& im, int ts, int& tw, int& th, vector<uchar>& rgb ) {
+            int w = im.w(), h = im.h(), ch = im.ch();
+            int f = std::max( 1, std::max( (w+ts-1)/ts, (h+ts-1)/ts ) );
+            tw = std::max( 1, w/f );
+            th = std::max( 1, h/f );
+            rgb.resize( 3*tw*th );
+            vector<int> acc( 3*tw );
+            for( int ty=0; ty<th; ty++ ) {
+                std::fill( acc.begin(), acc.end(), 0 );
+                for( int y=ty*f; y<(ty+1)*f; y++ ) {
+                    const uchar* row = im.get_row_u( y );
+                    for( int tx=0; tx<tw; tx++ ) {
+                        const uchar* p = row + ch*tx*f;
+                        int* a = &acc[3*tx];
+                        if( ch == 3 ) {
+                            for( int k=0; k<f; k++, p+=3 ) { a[0] += p[0]; a[1] += p[1]; a[2] += p[2]; }
+                        } else {
+                            for( int k=0; k<f; k++ ) a[0] += p[k];
+                        }
+                    }
+                }
+                int    area = f*f;
+                uchar* out  = &rgb[3*ty*tw];
+                for( int tx=0; tx<tw; tx++ ) {
+                    const int* a = &acc[3*tx];
+                    if( ch == 3 ) {
+                        out[3*tx+0] = a[0]/area;
+                        out[3*tx+1] = a[1]/area;
+                        out[3*tx+2] = a[2]/area;
+                    } else {
+                        out[3*tx+0] = out[3*tx+1] = out[3*tx+2] = a[0]/area;
+                    }
+                }
+            }
+        }
+
+        uint64_t fnv1a( const void* data, size_t n, uint64_t h=1469598103934665603ULL ) {
+            const uchar* p = (const uchar*)data;
+            for( size_t i=0; i<n; i++ ) {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+            return h;
+        }
+
+        const char thumb_magic[4] = { 'K', 'T', 'H', '1' };
+    }
+
+    ContactSheet::ContactSheet() : win( "contact sheet" ) {
+        tsize          = 128;
+        cache_capacity = 1024;
+        no_workers     = std::max( 1, (int)std::thread::hardware_concurrency() );
+        ww = wh = 0;
+        cols   = 1;
+        cell_w = cell_h = 0;
+        scroll = 0;
+        hover  = -1;
+        dirty  = true;
+        stop   = false;
+    }
+
+    ContactSheet::~ContactSheet() {
+        stop_workers();
+    }
+
+    void ContactSheet::set_files( const vector<string>& fs ) {
+        stop_workers();
+        files = fs;
+        cache.clear();
+        lru.clear();
+        results.clear();
+        scroll = 0;
+        hover  = -1;
+        dirty  = true;
+    }
+
+    //
+    // worker pool
+    //
+
+    void ContactSheet::start_workers() {
+        if( !workers.empty() ) return;
+        stop = false;
+        for( int i=0; i<no_workers; i++ )
+            workers.push_back( std::thread( &ContactSheet::work, this ) );
+    }
+
+    void ContactSheet::stop_workers() {
+        {
+            std::lock_guard<std::mutex> lock( mtx );
+            stop = true;
+            jobs.clear();
+        }
+        cv.notify_all();
+        for( size_t i=0; i<workers.size(); i++ )
+            workers[i].join();
+        workers.clear();
+        pending.clear();
+    }
+
+    void ContactSheet::work() {
+        while( 1 ) {
+            int i;
+            {
+                std::unique_lock<std::mutex> lock( mtx );
+                cv.wait( lock, [this]() { return stop || !jobs.empty(); } );
+                if( stop ) return;
+                i = jobs.front();
+                jobs.pop_front();
+            }
+
+            Thumb t;
+            if( !load_thumbnail( files[i], t ) ) {
+                // unreadable files get an empty thumbnail so they are not
+                // requested over and over
+                t.w = t.h = 0;
+            }
+
+            std::lock_guard<std::mutex> lock( mtx );
+            pending.erase( i );
+            results.push_back( std::make_pair( i, t ) );
+        }
+    }
+
+    // sidecar files are keyed by path, size, modification time and
+    // thumbnail size so edited images are picked up again
+    string ContactSheet::sidecar_file( const string& file ) const {
+        struct stat st;
+        if( stat( file.c_str(), &st ) != 0 ) return "";
+        uint64_t h = fnv1a( file.data(), file.size() );
+        int64_t  key[3] = { (int64_t)st.st_size, (int64_t)st.st_mtime, (int64_t)tsize };
+        h = fnv1a( key, sizeof(key), h );
+        char name[32];
+        sprintf( name, "%016llx.thm", (unsigned long long)h );
+        return sidecar + "/" + name;
+    }
+
+    bool ContactSheet::load_sidecar( const string& file, Thumb& t ) const {
+        string sname = sidecar_file( file );
+        if( sname.empty() ) return false;
+        FILE* fp = fopen( sname.c_str(), "rb" );
+        if( !fp ) return false;
+        char magic[4];
+        int  dims[2];
+        bool ok = fread( magic, 1, 4, fp ) == 4 && !memcmp( magic, thumb_magic, 4 ) &&
+                  fread( dims, sizeof(int), 2, fp ) == 2 &&
+                  dims[0] > 0 && dims[1] > 0 && dims[0] <= tsize && dims[1] <= tsize;
+        if( ok ) {
+            t.w = dims[0];
+            t.h = dims[1];
+            t.rgb.resize( 3*t.w*t.h );
+            ok = fread( t.rgb.data(), 1, t.rgb.size(), fp ) == t.rgb.size();
+        }
+        fclose( fp );
+        return ok;
+    }
+
+    void ContactSheet::save_sidecar( const string& file, const Thumb& t ) const {
+        string sname = sidecar_file( file );
+        if( sname.empty() ) return;
+        // write under a temporary name so that concurrent viewers never
+        // read a partial file
+        char suffix[32];
+        sprintf( suffix, ".%lx.tmp", (unsigned long)std::hash<std::thread::id>()( std::this_thread::get_id() ) );
+        string tname = sname + suffix;
+        FILE* fp = fopen( tname.c_str(), "wb" );
+        if( !fp ) return;
+        int  dims[2] = { t.w, t.h };
+        bool ok = fwrite( thumb_magic, 1, 4, fp ) == 4 &&
+                  fwrite( dims, sizeof(int), 2, fp ) == 2 &&
+                  fwrite( t.rgb.data(), 1, t.rgb.size(), fp ) == t.rgb.size();
+        ok = ( fclose( fp ) == 0 ) && ok;
+        if( !ok || rename( tname.c_str(), sname.c_str() ) != 0 )
+            remove( tname.c_str() );
+    }
+
+    bool ContactSheet::load_thumbnail( const string& file, Thumb& t ) const {
+        struct stat st;
+        if( stat( file.c_str(), &st ) != 0 || !S_ISREG( st.st_mode ) )
+            return false;
+        if( !sidecar.empty() && load_sidecar( file, t ) )
+            return true;
+
+        Image tmp;
+        tmp.load( file.c_str() );
+        if( tmp.w() == 0 || tmp.h() == 0 ) return false;
+        if     ( tmp.ch() == 3 && tmp.type() != IT_U_PRGB ) tmp.convert( IT_U_PRGB );
+        else if( tmp.ch() == 1 && tmp.type() != IT_U_GRAY ) tmp.convert( IT_U_GRAY );
+        else if( tmp.ch() != 1 && tmp.ch() != 3 )           return false;
+
+        downscale( tmp, tsize, t.w, t.h, t.rgb );
+
+        if( !sidecar.empty() )
+            save_sidecar( file, t );
+        return true;
+    }
+
+    //
+    // cache
+    //
+
+    void ContactSheet::touch( int i ) {
+        std::unordered_map<int,CacheEntry>::iterator it = cache.find( i );
+        if( it == cache.end() ) return;
+        lru.splice( lru.begin(), lru, it->second.lru );
+    }
+
+    // never less than a screen of cells
+    int ContactSheet::capacity() const {
+        return std::max( cache_capacity, cols*( wh/cell_h + 2 ) );
+    }
+
+    // drops the least recently drawn thumbnails. schedule() touches every
+    // cell it considers and never considers more than the capacity, so the
+    // cells in and around the view always stay resident.
+    void ContactSheet::evict() {
+        while( (int)cache.size() > capacity() ) {
+            int i = lru.back();
+            lru.pop_back();
+            cache.erase( i );
+        }
+    }
+
+    void ContactSheet::collect() {
+        vector< std::pair<int,Thumb> > done;
+        {
+            std::lock_guard<std::mutex> lock( mtx );
+            done.swap( results );
+        }
+        for( size_t k=0; k<done.size(); k++ ) {
+            int i = done[k].first;
+            if( cache.count( i ) ) continue;
+            lru.push_front( i );
+            CacheEntry& e = cache[i];
+            e.thumb.w = done[k].second.w;
+            e.thumb.h = done[k].second.h;
+            e.thumb.rgb.swap( done[k].second.rgb );
+            e.lru = lru.begin();
+            dirty = true;
+        }
+        evict();
+    }
+
+    // the visible cells are queued first, then one screen below and one
+    // above. the queue is rebuilt every frame so cells scrolled past are
+    // never decoded.
+    void ContactSheet::schedule() {
+        int n = (int)files.size();
+        if( n == 0 ) return;
+        int rows_in_view = wh / cell_h + 2;
+        int r0 = scroll / cell_h;
+
+        vector<int> want;
+        int budget     = capacity();
+        int considered = 0;
+        int ranges[3][2] = { { r0, r0+rows_in_view },
+                             { r0+rows_in_view, r0+2*rows_in_view },
+                             { r0-rows_in_view, r0 } };
+        for( int q=0; q<3; q++ ) {
+            int i0 = std::max( 0, ranges[q][0]*cols );
+            int i1 = std::min( n, ranges[q][1]*cols );
+            for( int i=i0; i<i1 && considered<budget; i++, considered++ ) {
+                if( cache.count( i ) ) touch( i );
+                else                   want.push_back( i );
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock( mtx );
+            for( size_t k=0; k<jobs.size(); k++ )
+                pending.erase( jobs[k] );
+            jobs.clear();
+            for( size_t k=0; k<want.size(); k++ ) {
+                if( pending.insert( want[k] ).second )
+                    jobs.push_back( want[k] );
+            }
+        }
+        cv.notify_all();
+    }
+
+    //
+    // display
+    //
+
+    void ContactSheet::layout() {
+        cell_w = tsize + cell_pad;
+        cell_h = tsize + cell_pad + label_height;
+        cols   = std::max( 1, ( ww - cell_pad ) / cell_w );
+    }
+
+    int ContactSheet::no_rows() const {
+        return ( (int)files.size() + cols-1 ) / cols;
+    }
+
+    int ContactSheet::max_scroll() const {
+        return std::max( 0, no_rows()*cell_h + cell_pad - wh );
+    }
+
+    void ContactSheet::scroll_to( int s ) {
+        s = std::min( max_scroll(), std::max( 0, s ) );
+        if( s == scroll ) return;
+        scroll = s;
+        dirty  = true;
+    }
+
+    int ContactSheet::cell_at( int x, int y ) const {
+        int gy = y + scroll;
+        int c  = ( x - cell_pad ) / cell_w;
+        int r  = gy / cell_h;
+        if( x < cell_pad || c >= cols || gy < 0 ) return -1;
+        int i = r*cols + c;
+        if( i >= (int)files.size() ) return -1;
+        return i;
+    }
+
+    void ContactSheet::draw() {
+        win.reset_display();
+        int n  = (int)files.size();
+        int r0 = scroll / cell_h;
+        int r1 = std::min( no_rows(), ( scroll + wh ) / cell_h + 1 );
+
+        win.set_thickness( 1 );
+        win.set_font( 0.35f, 0.35f );
+        for( int r=r0; r<r1; r++ ) {
+            for( int c=0; c<cols; c++ ) {
+                int i = r*cols + c;
+                if( i >= n ) break;
+                int x = cell_pad + c*cell_w;
+                int y = cell_pad + r*cell_h - scroll;
+
+                std::unordered_map<int,CacheEntry>::const_iterator it = cache.find( i );
+                if( it != cache.end() && it->second.thumb.w > 0 ) {
+                    const Thumb& t = it->second.thumb;
+                    win.draw_image( t.rgb.data(), NULL, x + (tsize-t.w)/2, y + (tsize-t.h)/2, t.w, t.h );
+                } else {
+                    win.set_color( 60, 60, 60 );
+                    win.draw_rectangle( x, y, tsize, tsize );
+                }
+
+                if( i == hover ) {
+                    win.set_color( 255, 255, 0 );
+                    win.draw_rectangle( x-2, y-2, tsize+4, tsize+4 );
+                }
+
+                string label = files[i];
+                size_t slash = label.find_last_of( '/' );
+                if( slash != string::npos ) label = label.substr( slash+1 );
+                int max_chars = tsize / 6;
+                if( (int)label.size() > max_chars ) label = label.substr( 0, max_chars-2 ) + "..";
+                win.set_color( 200, 200, 200 );
+                win.write( x, y + tsize + label_height - 3, label );
+            }
+        }
+
+        // scroll bar
+        int ms = max_scroll();
+        if( ms > 0 ) {
+            int bh = std::max( 10, wh * wh / ( ms + wh ) );
+            int by = (int)( (double)scroll / ms * ( wh - bh ) );
+            win.set_color( 120, 120, 120 );
+            win.draw_rectangle( ww-6, by, 4, bh );
+        }
+        win.refresh();
+        dirty = false;
+    }
+
+    bool ContactSheet::catch_keyboard() {
+        int c = win.wait( 10 );
+        int page = std::max( cell_h, ( wh / cell_h ) * cell_h );
+        if     ( c == 'q' ) return false;
+        else if( c == 'j' ) scroll_to( scroll + cell_h );
+        else if( c == 'k' ) scroll_to( scroll - cell_h );
+        else if( c == ' ' ) scroll_to( scroll + page );
+        else if( c == 'b' ) scroll_to( scroll - page );
+        else if( c == 'g' ) scroll_to( 0 );
+        else if( c == 'G' ) scroll_to( max_scroll() );
+        return true;
+    }
+
+    void ContactSheet::catch_mouse() {
+        int x, y;
+        if( win.mouse_move_event( x, y ) ) {
+            int i = cell_at( x, y );
+            if( i != hover ) {
+                hover = i;
+                dirty = true;
+            }
+            win.reset_mouse();
+        }
+        if( !win.mouse_click( MOUSE_LCLICK, x, y ) )
+            return;
+        win.reset_mouse();
+        int i = cell_at( x, y );
+        if( i != -1 )
+            open_image( i );
+    }
+
+    void ContactSheet::open_image( int i ) {
+        Image img;
+        img.load( files[i].c_str() );
+        if( img.w() == 0 || img.h() == 0 ) {
+            printf( "could not load [%s]\n", files[i].c_str() );
+            return;
+        }
+        printf( "%s [%d x %d]\n", files[i].c_str(), img.w(), img.h() );
+        {
+            ImageGUI g;
+            g.setup( &img );
+            g.create( std::min( 1200, img.w() ) );
+            g.display();
+        }
+        // the image window took over the shared mouse callback
+        win.init_mouse();
+        dirty = true;
+    }
+
+    void ContactSheet::create( int w, int h ) {
+        passert_statement( w > 0 && h > 0, "invalid contact sheet size" );
+        ww = w;
+        wh = h;
+        layout();
+        win.create_display( ww, wh );
+        win.create( 0 );
+        win.resize( ww, wh );
+        win.move( 0, 0 );
+        win.init_mouse();
+        win.show();
+    }
+
+    void ContactSheet::display() {
+        passert_statement( ww > 0, "call create before display" );
+        passert_statement( cache_capacity > 0 && tsize > 0, "invalid contact sheet settings" );
+        layout();
+        scroll_to( scroll );
+        start_workers();
+        win.reset_mouse();
+        while( 1 ) {
+            collect();
+            schedule();
+            if( dirty ) draw();
+            if( !catch_keyboard() )
+                break;
+            catch_mouse();
+        }
+        stop_workers();
+    }
+
+    void contact_sheet( const vector<string>& files, int w, int h ) {
+        ContactSheet cs;
+        cs.set_files( files );
+        cs.create( w, h );
+        cs.display();
+    }
+
+}
@@ -0,0 +1,639 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifdef WITH_OPENCV
+
+#include "kortex/display_list.h"
+#include "kortex/opencv_extensions.h"
+#include "kortex/buffer_pool.h"
+#include <kortex/image.h>
+#include <kortex/check.h>
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <climits>
+
+namespace kortex {
+
+    namespace {
+        enum {
+            OP_FRAME = 1, OP_SAVE, OP_CLEAR,
+            OP_COLOR, OP_THICKNESS, OP_FONT,
+            OP_LINE, OP_RAY, OP_RECTANGLE, OP_CIRCLE, OP_POLYGON,
+            OP_IMAGE, OP_MARK, OP_REGION, OP_TEXT, OP_POLYLINES,
+            OP_IMAGE_REF
+        };
+
+        const char display_list_magic[8] = { 'K','D','L','I','S','T','0','1' };
+
+        // one decoded operation. pixel data of images points into the list,
+        // regions are decoded into (row, start, length) runs.
+        struct Command {
+            int          op;
+            int          v[6];
+            float        f[4];
+            const uchar* rgb;
+            const uchar* mask;
+            vector<int>  pts;
+            vector<int>  counts;   // points per line of OP_POLYLINES
+            string       text;
+        };
+
+        class Reader {
+        public:
+            Reader( const uchar* b, const uchar* e ) { p = start = b; end = e; }
+
+            bool done() const { return p >= end; }
+            const uchar* pos() const { return p; }
+            size_t offset() const { return p - start; }
+
+            unsigned get_uint() {
+                unsigned v = 0;
+                int s = 0;
+                while( p < end ) {
+                    uchar c = *p++;
+                    v |= unsigned( c & 0x7f ) << s;
+                    if( !( c & 0x80 ) ) break;
+                    s += 7;
+                }
+                return v;
+            }
+            int get_int() {
+                unsigned v = get_uint();
+                return int( v >> 1 ) ^ -int( v & 1 );
+            }
+            float get_float() {
+                float v;
+                passert_statement( p+sizeof(v) <= end, "truncated display list" );
+                memcpy( &v, p, sizeof(v) );
+                p += sizeof(v);
+                return v;
+            }
+            const uchar* get_bytes( size_t n ) {
+                passert_statement( p+n <= end, "truncated display list" );
+                const uchar* b = p;
+                p += n;
+                return b;
+            }
+
+        private:
+            const uchar* start;
+            const uchar* p;
+            const uchar* end;
+        };
+
+        // fnv-1a over the pixels and the mask
+        size_t hash_image( const uchar* rgb, const uchar* mask, size_t np ) {
+            unsigned long long h = 14695981039346656037ULL;
+            for( size_t i=0; i<3*np; i++ ) { h ^= rgb[i]; h *= 1099511628211ULL; }
+            if( mask )
+                for( size_t i=0; i<np; i++ ) { h ^= mask[i]; h *= 1099511628211ULL; }
+            h ^= np;
+            return (size_t)h;
+        }
+
+        void next_command( Reader& r, Command& c ) {
+            const uchar* op_pos = r.pos();
+            size_t       op_off = r.offset();
+            c.op = r.get_uint();
+            switch( c.op ) {
+            case OP_FRAME:
+            case OP_SAVE:
+            case OP_CLEAR:
+                break;
+            case OP_COLOR:
+                c.v[0] = r.get_uint();
+                break;
+            case OP_THICKNESS:
+                c.v[0] = r.get_int();
+                break;
+            case OP_FONT:
+                for( int k=0; k<4; k++ ) c.f[k] = r.get_float();
+                break;
+            case OP_LINE:
+            case OP_RECTANGLE:
+                for( int k=0; k<4; k++ ) c.v[k] = r.get_int();
+                break;
+            case OP_RAY:
+                c.v[0] = r.get_int();
+                c.v[1] = r.get_int();
+                c.f[0] = r.get_float();
+                c.f[1] = r.get_float();
+                break;
+            case OP_CIRCLE:
+            case OP_MARK:
+                for( int k=0; k<3; k++ ) c.v[k] = r.get_int();
+                break;
+            case OP_POLYGON: {
+                int n = r.get_uint();
+                c.pts.resize( 2*n );
+                for( int k=0; k<2*n; k++ ) c.pts[k] = r.get_int();
+            } break;
+            case OP_IMAGE: {
+                for( int k=0; k<4; k++ ) c.v[k] = r.get_int();
+                size_t np = size_t( c.v[2] ) * c.v[3];
+                bool has_mask = r.get_uint();
+                c.rgb  = r.get_bytes( 3*np );
+                c.mask = has_mask ? r.get_bytes( np ) : NULL;
+            } break;
+            case OP_IMAGE_REF: {
+                // an earlier OP_IMAGE drawn again at x, y. it is decoded as
+                // that image so that replay only knows OP_IMAGE.
+                int x = r.get_int();
+                int y = r.get_int();
+                size_t back = r.get_uint();
+                passert_statement( back > 0 && back <= op_off, "corrupt display list" );
+                Reader ir( op_pos-back, op_pos );
+                next_command( ir, c );
+                passert_statement( c.op == OP_IMAGE, "corrupt display list" );
+                c.v[0] = x;
+                c.v[1] = y;
+            } break;
+            case OP_REGION: {
+                c.v[0] = r.get_uint(); // permanent
+                int h  = r.get_uint();
+                c.pts.clear();
+                for( int y=0; y<h; y++ ) {
+                    int nr = r.get_uint();
+                    int x  = 0;
+                    for( int k=0; k<nr; k++ ) {
+                        x += r.get_uint();
+                        int len = r.get_uint();
+                        c.pts.push_back( y   );
+                        c.pts.push_back( x   );
+                        c.pts.push_back( len );
+                        x += len;
+                    }
+                }
+            } break;
+            case OP_TEXT: {
+                c.v[0] = r.get_int();
+                c.v[1] = r.get_int();
+                int n = r.get_uint();
+                c.text.assign( (const char*)r.get_bytes( n ), n );
+            } break;
+            case OP_POLYLINES: {
+                int nl = r.get_uint();
+                c.counts.resize( nl );
+                int np = 0;
+                for( int k=0; k<nl; k++ ) np += c.counts[k] = r.get_uint();
+                c.pts.resize( 2*np );
+                for( int k=0; k<2*np; k++ ) c.pts[k] = r.get_int();
+            } break;
+            default:
+                passert_statement( 0, "corrupt display list" );
+            }
+        }
+
+        inline int scale_coord( int v, double s ) { return (int)floor( v*s + 0.5 ); }
+
+        // filled shapes (negative thickness) stay filled, lines never vanish
+        inline int scale_thickness( int t, double s ) {
+            if( t <= 0 ) return t;
+            return std::max( 1, (int)floor( t*s + 0.5 ) );
+        }
+
+        struct ReplayState {
+            Color  col;
+            int    thickness;
+            CvFont font;
+        };
+    }
+
+    DisplayList::DisplayList() {
+        sw = sh = 0;
+        clear();
+    }
+
+    void DisplayList::clear() {
+        buf.clear();
+        frames.assign( 1, 0 );
+        persists.assign( 1, 0 );
+        last_color     = -1;
+        last_thickness = INT_MIN;
+        images.clear();
+    }
+
+    void DisplayList::begin( int w, int h ) {
+        clear();
+        sw = w;
+        sh = h;
+    }
+
+    void DisplayList::assign( int w, int h, const uchar* data, size_t n ) {
+        begin( w, h );
+        buf.assign( data, data+n );
+        index_frames();
+    }
+
+    void DisplayList::put_op( int op ) {
+        buf.push_back( (uchar)op );
+    }
+
+    void DisplayList::put_uint( unsigned v ) {
+        while( v >= 0x80 ) {
+            buf.push_back( uchar( v | 0x80 ) );
+            v >>= 7;
+        }
+        buf.push_back( uchar( v ) );
+    }
+
+    // zig-zag coding keeps small negative offsets short
+    void DisplayList::put_int( int v ) {
+        put_uint( ( unsigned( v ) << 1 ) ^ unsigned( v >> 31 ) );
+    }
+
+    void DisplayList::put_float( float v ) {
+        put_bytes( (const uchar*)&v, sizeof(v) );
+    }
+
+    void DisplayList::put_bytes( const uchar* p, size_t n ) {
+        buf.insert( buf.end(), p, p+n );
+    }
+
+    void DisplayList::set_color( const Color& col ) {
+        int c = ( col.r << 16 ) | ( col.g << 8 ) | col.b;
+        if( c == last_color ) return;
+        last_color = c;
+        put_op( OP_COLOR );
+        put_uint( c );
+    }
+
+    void DisplayList::set_thickness( int t ) {
+        if( t == last_thickness ) return;
+        last_thickness = t;
+        put_op( OP_THICKNESS );
+        put_int( t );
+    }
+
+    void DisplayList::set_font( float hs, float vs, float shear, float thickness ) {
+        put_op( OP_FONT );
+        put_float( hs    );
+        put_float( vs    );
+        put_float( shear );
+        put_float( thickness );
+    }
+
+    void DisplayList::reset_display() {
+        frames.push_back( buf.size() );
+        persists.push_back( 0 );
+        put_op( OP_FRAME );
+    }
+
+    void DisplayList::save_display() {
+        put_op( OP_SAVE );
+        persists.back() = 1;
+    }
+
+    void DisplayList::clear_display() {
+        put_op( OP_CLEAR );
+        persists.back() = 1;
+    }
+
+    void DisplayList::draw_line( int x0, int y0, int x1, int y1 ) {
+        put_op( OP_LINE );
+        put_int( x0 ); put_int( y0 );
+        put_int( x1 ); put_int( y1 );
+    }
+
+    void DisplayList::draw_ray( int x0, int y0, float length, float angle ) {
+        put_op( OP_RAY );
+        put_int( x0 ); put_int( y0 );
+        put_float( length );
+        put_float( angle  );
+    }
+
+    void DisplayList::draw_rectangle( int x, int y, int dw, int dh ) {
+        put_op( OP_RECTANGLE );
+        put_int( x  ); put_int( y  );
+        put_int( dw ); put_int( dh );
+    }
+
+    void DisplayList::draw_circle( int x, int y, int dr ) {
+        put_op( OP_CIRCLE );
+        put_int( x ); put_int( y ); put_int( dr );
+    }
+
+    void DisplayList::draw_polygon( const int* xy, int no_points ) {
+        put_op( OP_POLYGON );
+        put_uint( no_points );
+        for( int k=0; k<2*no_points; k++ )
+            put_int( xy[k] );
+    }
+
+    void DisplayList::draw_polylines( const int* xy, const int* counts, int no_lines ) {
+        put_op( OP_POLYLINES );
+        put_uint( no_lines );
+        int np = 0;
+        for( int k=0; k<no_lines; k++ ) {
+            put_uint( counts[k] );
+            np += counts[k];
+        }
+        for( int k=0; k<2*np; k++ )
+            put_int( xy[k] );
+    }
+
+    void DisplayList::draw_image( const uchar* rgb, const uchar* mask, int x, int y, int iw, int ih ) {
+        size_t np = size_t(iw)*ih;
+        size_t h  = hash_image( rgb, mask, np );
+        typedef std::unordered_multimap<size_t,size_t>::const_iterator It;
+        std::pair<It,It> range = images.equal_range( h );
+        for( It it=range.first; it!=range.second; ++it ) {
+            Reader  r( buf.data()+it->second, buf.data()+buf.size() );
+            Command c;
+            next_command( r, c );
+            if( c.v[2] != iw || c.v[3] != ih || ( c.mask != NULL ) != ( mask != NULL ) ) continue;
+            if( memcmp( c.rgb, rgb, 3*np ) || ( mask && memcmp( c.mask, mask, np ) ) ) continue;
+            size_t back = buf.size() - it->second;
+            if( back > 0xffffffffu ) break;
+            put_op( OP_IMAGE_REF );
+            put_int( x ); put_int( y );
+            put_uint( (unsigned)back );
+            return;
+        }
+        images.insert( std::make_pair( h, buf.size() ) );
+        put_op( OP_IMAGE );
+        put_int( x  ); put_int( y  );
+        put_int( iw ); put_int( ih );
+        put_uint( mask ? 1 : 0 );
+        put_bytes( rgb, 3*size_t(iw)*ih );
+        if( mask ) put_bytes( mask, size_t(iw)*ih );
+    }
+
+    void DisplayList::mark( int x, int y, int thickness ) {
+        put_op( OP_MARK );
+        put_int( x ); put_int( y ); put_int( thickness );
+    }
+
+    // the occupancy map is stored as runs of marked pixels per row
+    void DisplayList::mark_region( const int* mark, bool permanent ) {
+        put_op( OP_REGION );
+        put_uint( permanent );
+        put_uint( sh );
+        vector<int> runs;
+        for( int y=0; y<sh; y++ ) {
+            const int* row = mark + y*sw;
+            runs.clear();
+            for( int x=0; x<sw; ) {
+                if( !row[x] ) { x++; continue; }
+                int x0 = x;
+                while( x < sw && row[x] ) x++;
+                runs.push_back( x0   );
+                runs.push_back( x-x0 );
+            }
+            put_uint( runs.size()/2 );
+            int prev = 0;
+            for( size_t k=0; k<runs.size(); k+=2 ) {
+                put_uint( runs[k] - prev );
+                put_uint( runs[k+1] );
+                prev = runs[k] + runs[k+1];
+            }
+        }
+        if( permanent ) persists.back() = 1;
+    }
+
+    void DisplayList::write( int x, int y, const string& text ) {
+        put_op( OP_TEXT );
+        put_int( x ); put_int( y );
+        put_uint( text.size() );
+        put_bytes( (const uchar*)text.data(), text.size() );
+    }
+
+    void DisplayList::index_frames() {
+        frames.assign( 1, 0 );
+        persists.assign( 1, 0 );
+        Reader r( buf.data(), buf.data()+buf.size() );
+        Command c;
+        while( !r.done() ) {
+            size_t off = r.pos() - buf.data();
+            next_command( r, c );
+            if( c.op == OP_FRAME ) {
+                frames.push_back( off );
+                persists.push_back( 0 );
+            } else if( c.op == OP_SAVE || c.op == OP_CLEAR || ( c.op == OP_REGION && c.v[0] ) ) {
+                persists.back() = 1;
+            }
+        }
+    }
+
+    void DisplayList::replay( IplImage* target, int frame ) const {
+        assert_pointer( target );
+        passert_statement( target->nChannels == 3 && target->depth == IPL_DEPTH_8U, "invalid replay target" );
+        passert_statement( sw > 0 && sh > 0, "display list has no size" );
+        if( frame < 0 ) frame = no_frames()-1;
+        passert_statement( frame < no_frames(), "invalid frame" );
+
+        int    tw = target->width;
+        int    th = target->height;
+        double sx = tw / double( sw );
+        double sy = th / double( sh );
+        double ss = 0.5 * ( sx + sy );
+
+        ReplayState st;
+        st.col       = Color( 255, 0, 0 );
+        st.thickness = 1;
+        cvInitFont( &st.font, CV_FONT_HERSHEY_PLAIN, sx, sy, 0, scale_thickness( 1, ss ), CV_AA );
+
+        IplImage* bg = create_pooled_image( tw, th, 3 );
+        cvCopy( target, bg );
+        vector<int> occ;
+
+        size_t end = ( frame+1 < no_frames() ) ? frames[frame+1] : buf.size();
+        Reader r( buf.data(), buf.data()+end );
+        Command c;
+        int  k    = 0;
+        bool draw = ( frame == 0 ) || persists[0];
+        while( !r.done() ) {
+            next_command( r, c );
+            switch( c.op ) {
+            case OP_FRAME:
+                k++;
+                draw = ( k == frame ) || persists[k];
+                if( draw ) cvCopy( bg, target );
+                break;
+            case OP_COLOR:
+                st.col = Color( ( c.v[0] >> 16 ) & 0xff, ( c.v[0] >> 8 ) & 0xff, c.v[0] & 0xff );
+                break;
+            case OP_THICKNESS:
+                st.thickness = c.v[0];
+                break;
+            case OP_FONT:
+                cvInitFont( &st.font, CV_FONT_HERSHEY_PLAIN, c.f[0]*sx, c.f[1]*sy, c.f[2],
+                            scale_thickness( (int)c.f[3], ss ), CV_AA );
+                break;
+            default:
+                break;
+            }
+            if( !draw ) continue;
+
+            int t = scale_thickness( st.thickness, ss );
+            switch( c.op ) {
+            case OP_SAVE:
+                cvCopy( target, bg );
+                break;
+            case OP_CLEAR:
+                cvSet( bg, cvScalar(0,0,0) );
+                cvCopy( bg, target );
+                break;
+            case OP_LINE:
+                kortex::draw_line( target, scale_coord( c.v[0], sx ), scale_coord( c.v[1], sy ),
+                                   scale_coord( c.v[2], sx ), scale_coord( c.v[3], sy ), &st.col, t );
+                break;
+            case OP_RAY:
+                kortex::draw_ray( target, scale_coord( c.v[0], sx ), scale_coord( c.v[1], sy ),
+                                  c.f[0]*ss, c.f[1], &st.col, t );
+                break;
+            case OP_RECTANGLE: {
+                int x0 = scale_coord( c.v[0], sx ), x1 = scale_coord( c.v[0]+c.v[2], sx );
+                int y0 = scale_coord( c.v[1], sy ), y1 = scale_coord( c.v[1]+c.v[3], sy );
+                kortex::draw_rectangle( target, x0, y0, x1-x0, y1-y0, &st.col, t );
+            } break;
+            case OP_CIRCLE:
+                kortex::draw_circle( target, scale_coord( c.v[0], sx ), scale_coord( c.v[1], sy ),
+                                     std::max( 1, scale_coord( c.v[2], ss ) ), &st.col, t );
+                break;
+            case OP_POLYGON: {
+                for( size_t i=0; i<c.pts.size(); i+=2 ) {
+                    c.pts[i  ] = scale_coord( c.pts[i  ], sx );
+                    c.pts[i+1] = scale_coord( c.pts[i+1], sy );
+                }
+                if( !c.pts.empty() )
+                    kortex::draw_polygon( target, c.pts.data(), (int)c.pts.size()/2, &st.col, t );
+            } break;
+            case OP_POLYLINES: {
+                for( size_t i=0; i<c.pts.size(); i+=2 ) {
+                    c.pts[i  ] = scale_coord( c.pts[i  ], sx );
+                    c.pts[i+1] = scale_coord( c.pts[i+1], sy );
+                }
+                kortex::draw_polylines( target, c.pts.data(), c.counts.data(), (int)c.counts.size(), &st.col, t );
+            } break;
+            case OP_MARK: {
+                int x = scale_coord( c.v[0], sx );
+                int y = scale_coord( c.v[1], sy );
+                if( x < 0 || x >= tw || y < 0 || y >= th ) break;
+                if( c.v[2] == 0 ) {
+                    int ps = std::max( 1, (int)floor( ss+0.5 ) );
+                    if( ps == 1 ) kortex::draw_marker( target, x, y, &st.col, 0 );
+                    else          cvRectangle( target, cvPoint(x,y), cvPoint(x+ps-1,y+ps-1),
+                                               cvScalar( st.col.b, st.col.g, st.col.r ), -1 );
+                } else {
+                    kortex::draw_circle( target, x, y, std::max( 2, scale_coord( 2, ss ) ), &st.col,
+                                         scale_thickness( c.v[2], ss ) );
+                }
+            } break;
+            case OP_TEXT:
+                // write_on_image puts the baseline 10 pixels below y
+                kortex::write_on_image( target, scale_coord( c.v[0], sx ), scale_coord( c.v[1]+10, sy )-10,
+                                        c.text, &st.col, &st.font );
+                break;
+            case OP_IMAGE: {
+                int x0 = scale_coord( c.v[0], sx ), x1 = scale_coord( c.v[0]+c.v[2], sx );
+                int y0 = scale_coord( c.v[1], sy ), y1 = scale_coord( c.v[1]+c.v[3], sy );
+                int iw = c.v[2], ih = c.v[3];
+                for( int ty=std::max( 0, y0 ); ty<std::min( th, y1 ); ty++ ) {
+                    int r = std::min( ih-1, (int)( ( ty-y0+0.5 ) * ih / ( y1-y0 ) ) );
+                    uchar* drow = (uchar*)( target->imageData + ty*target->widthStep );
+                    for( int tx=std::max( 0, x0 ); tx<std::min( tw, x1 ); tx++ ) {
+                        int q = std::min( iw-1, (int)( ( tx-x0+0.5 ) * iw / ( x1-x0 ) ) );
+                        size_t i = size_t( r )*iw + q;
+                        if( c.mask && !c.mask[i] ) continue;
+                        drow[3*tx+0] = c.rgb[3*i+2];
+                        drow[3*tx+1] = c.rgb[3*i+1];
+                        drow[3*tx+2] = c.rgb[3*i+0];
+                    }
+                }
+            } break;
+            case OP_REGION: {
+                occ.assign( size_t( tw )*th, 0 );
+                for( size_t i=0; i<c.pts.size(); i+=3 ) {
+                    int ry0 = std::max( 0,  scale_coord( c.pts[i],   sy ) );
+                    int ry1 = std::min( th, scale_coord( c.pts[i]+1, sy ) );
+                    int rx0 = std::max( 0,  scale_coord( c.pts[i+1], sx ) );
+                    int rx1 = std::min( tw, scale_coord( c.pts[i+1]+c.pts[i+2], sx ) );
+                    for( int y=ry0; y<ry1; y++ )
+                        std::fill( occ.begin()+size_t(y)*tw+rx0, occ.begin()+size_t(y)*tw+std::max( rx0, rx1 ), 1 );
+                }
+                if( c.v[0] ) {
+                    overlay_region( bg, occ.data() );
+                    cvCopy( bg, target );
+                } else {
+                    overlay_region( target, occ.data() );
+                }
+            } break;
+            default:
+                break;
+            }
+        }
+        release_pooled_image( &bg );
+    }
+
+    void DisplayList::render( const Image* background, Image* out, int frame ) const {
+        assert_pointer( background && out );
+        IplImage* ipl = create_pooled_image( background->w(), background->h(), 3 );
+        copy_image_to_color_ipl( background, ipl );
+        replay( ipl, frame );
+        copy_ipl_to_image( ipl, out );
+        release_pooled_image( &ipl );
+    }
+
+    void DisplayList::render( int ow, int oh, Image* out, int frame ) const {
+        assert_pointer( out );
+        IplImage* ipl = create_pooled_image( ow, oh, 3 );
+        cvSet( ipl, cvScalar(0,0,0) );
+        replay( ipl, frame );
+        copy_ipl_to_image( ipl, out );
+        release_pooled_image( &ipl );
+    }
+
+    void DisplayList::save( const string& file ) const {
+        FILE* fp = fopen( file.c_str(), "wb" );
+        passert_statement( fp, "could not open display list file" );
+        int       dims[2] = { sw, sh };
+        long long nb      = (long long)buf.size();
+        bool ok = fwrite( display_list_magic, 1, 8, fp ) == 8 &&
+                  fwrite( dims, sizeof(int), 2, fp ) == 2 &&
+                  fwrite( &nb, sizeof(nb), 1, fp ) == 1 &&
+                  fwrite( buf.data(), 1, buf.size(), fp ) == buf.size();
+        fclose( fp );
+        passert_statement( ok, "could not write display list" );
+    }
+
+    void DisplayList::load( const string& file ) {
+        FILE* fp = fopen( file.c_str(), "rb" );
+        passert_statement( fp, "could not open display list file" );
+        char      magic[8];
+        int       dims[2];
+        long long nb = 0;
+        bool ok = fread( magic, 1, 8, fp ) == 8 && !memcmp( magic, display_list_magic, 8 ) &&
+                  fread( dims, sizeof(int), 2, fp ) == 2 &&
+                  fread( &nb, sizeof(nb), 1, fp ) == 1 && nb >= 0;
+        if( ok ) {
+            buf.resize( (size_t)nb );
+            ok = fread( buf.data(), 1, buf.size(), fp ) == buf.size();
+        }
+        fclose( fp );
+        passert_statement( ok, "invalid display list file" );
+        sw = dims[0];
+        sh = dims[1];
+        last_color     = -1;
+        last_thickness = INT_MIN;
+        index_frames();
+    }
+
+}
+
+#endif
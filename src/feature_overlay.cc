@@ -0,0 +1,225 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/feature_overlay.h"
+#include "kortex/gui_window.h"
+#include "kortex/view_transform.h"
+#include <kortex/check.h>
+
+#include <cmath>
+#include <algorithm>
+
+namespace kortex {
+
+    FeatureOverlay::FeatureOverlay() {
+        ox = oy = 0.0f;
+        cell = 16;
+        color = Color( 0, 255, 255 );
+        max_primitives = 20000;
+        bbuilt = false;
+    }
+
+    void FeatureOverlay::clear() {
+        fx.clear();
+        fy.clear();
+        fr.clear();
+        cell_start.clear();
+        levels.clear();
+        bbuilt = false;
+    }
+
+    void FeatureOverlay::add( float x, float y, float radius ) {
+        fx.push_back( x );
+        fy.push_back( y );
+        fr.push_back( radius );
+        bbuilt = false;
+    }
+
+    void FeatureOverlay::build( int cell_size ) {
+        passert_statement( cell_size > 0, "invalid cell size" );
+        cell_start.clear();
+        levels.clear();
+        bbuilt = true;
+
+        int n = (int)fx.size();
+        if( n == 0 ) return;
+
+        float xmin = *std::min_element( fx.begin(), fx.end() );
+        float xmax = *std::max_element( fx.begin(), fx.end() );
+        float ymin = *std::min_element( fy.begin(), fy.end() );
+        float ymax = *std::max_element( fy.begin(), fy.end() );
+        ox = xmin;
+        oy = ymin;
+
+        // keep the grid proportional to the feature count even for sparse
+        // sets with far outliers
+        cell = cell_size;
+        int gw, gh;
+        while( 1 ) {
+            gw = (int)( (xmax-ox)/cell ) + 1;
+            gh = (int)( (ymax-oy)/cell ) + 1;
+            if( double(gw)*gh <= 4.0*n + 4096 ) break;
+            cell *= 2;
+        }
+
+        Level l0;
+        l0.w = gw;
+        l0.h = gh;
+        l0.count.assign( gw*gh, 0 );
+        l0.sx.assign( gw*gh, 0.0f );
+        l0.sy.assign( gw*gh, 0.0f );
+
+        vector<int> cid( n );
+        for( int i=0; i<n; i++ ) {
+            int cx = std::min( gw-1, (int)( (fx[i]-ox)/cell ) );
+            int cy = std::min( gh-1, (int)( (fy[i]-oy)/cell ) );
+            cid[i] = cy*gw + cx;
+            l0.count[ cid[i] ]++;
+            l0.sx[ cid[i] ] += fx[i];
+            l0.sy[ cid[i] ] += fy[i];
+        }
+
+        // counting sort of the features by cell
+        cell_start.assign( gw*gh+1, 0 );
+        for( int c=0; c<gw*gh; c++ )
+            cell_start[c+1] = cell_start[c] + l0.count[c];
+
+        vector<int>   pos( cell_start.begin(), cell_start.end()-1 );
+        vector<float> sx( n ), sy( n ), sr( n );
+        for( int i=0; i<n; i++ ) {
+            int p = pos[ cid[i] ]++;
+            sx[p] = fx[i];
+            sy[p] = fy[i];
+            sr[p] = fr[i];
+        }
+        fx.swap( sx );
+        fy.swap( sy );
+        fr.swap( sr );
+
+        levels.push_back( l0 );
+        while( levels.back().w > 1 || levels.back().h > 1 ) {
+            const Level& pl = levels.back();
+            Level nl;
+            nl.w = ( pl.w+1 )/2;
+            nl.h = ( pl.h+1 )/2;
+            nl.count.assign( nl.w*nl.h, 0 );
+            nl.sx.assign( nl.w*nl.h, 0.0f );
+            nl.sy.assign( nl.w*nl.h, 0.0f );
+            for( int y=0; y<pl.h; y++ ) {
+                for( int x=0; x<pl.w; x++ ) {
+                    int pc = y*pl.w + x;
+                    int nc = (y/2)*nl.w + x/2;
+                    nl.count[nc] += pl.count[pc];
+                    nl.sx[nc]    += pl.sx[pc];
+                    nl.sy[nc]    += pl.sy[pc];
+                }
+            }
+            levels.push_back( nl );
+        }
+    }
+
+    void FeatureOverlay::cell_range( const Level& lv, int lsz, const ViewTransform& view, int dw, int dh,
+                                     int& cx0, int& cy0, int& cx1, int& cy1 ) const {
+        double ix0, iy0, ix1, iy1;
+        view.visible_region( dw, dh, ix0, iy0, ix1, iy1 );
+        cx0 = std::max( 0,      (int)floor( (ix0-ox)/lsz ) );
+        cy0 = std::max( 0,      (int)floor( (iy0-oy)/lsz ) );
+        cx1 = std::min( lv.w-1, (int)floor( (ix1-ox)/lsz ) );
+        cy1 = std::min( lv.h-1, (int)floor( (iy1-oy)/lsz ) );
+    }
+
+    void FeatureOverlay::draw( GUIWindow* win, const ViewTransform& view ) const {
+        assert_pointer( win );
+        passert_statement( bbuilt, "build() the overlay before drawing it" );
+        if( fx.empty() ) return;
+
+        int dw = win->w();
+        int dh = win->h();
+
+        // finest level whose cells still cover at least 8 display pixels
+        int l = 0;
+        while( l+1 < (int)levels.size() && cell*double(1<<l)/view.scale < 8.0 )
+            l++;
+
+        const Level& lv = levels[l];
+        int cx0, cy0, cx1, cy1;
+        cell_range( lv, cell<<l, view, dw, dh, cx0, cy0, cx1, cy1 );
+
+        int visible = 0;
+        for( int cy=cy0; cy<=cy1; cy++ )
+            for( int cx=cx0; cx<=cx1; cx++ )
+                visible += lv.count[ cy*lv.w+cx ];
+
+        int thickness = win->get_thickness();
+        if( visible <= max_primitives ) draw_features  ( win, view );
+        else                            draw_aggregated( win, view, l );
+        win->set_thickness( thickness );
+    }
+
+    void FeatureOverlay::draw_features( GUIWindow* win, const ViewTransform& view ) const {
+        int dw = win->w();
+        int dh = win->h();
+        const Level& lv = levels[0];
+        int cx0, cy0, cx1, cy1;
+        cell_range( lv, cell, view, dw, dh, cx0, cy0, cx1, cy1 );
+
+        win->set_color( color );
+        win->set_thickness( 1 );
+        for( int cy=cy0; cy<=cy1; cy++ ) {
+            for( int cx=cx0; cx<=cx1; cx++ ) {
+                int c = cy*lv.w + cx;
+                for( int i=cell_start[c]; i<cell_start[c+1]; i++ ) {
+                    double dx, dy;
+                    view.image_to_display( fx[i], fy[i], dx, dy );
+                    if( dx < 0 || dy < 0 || dx >= dw || dy >= dh ) continue;
+                    float r = fr[i] / view.scale;
+                    if( r < 1.5f ) win->mark( (int)dx, (int)dy, 0 );
+                    else           win->draw_circle( (int)dx, (int)dy, (int)(r+0.5f) );
+                }
+            }
+        }
+    }
+
+    // one filled disc per non-empty cell at its centroid. the disc grows with
+    // the count and its color ramps with the log density of the viewport.
+    void FeatureOverlay::draw_aggregated( GUIWindow* win, const ViewTransform& view, int l ) const {
+        const Level& lv = levels[l];
+        int lsz = cell<<l;
+        int cx0, cy0, cx1, cy1;
+        cell_range( lv, lsz, view, win->w(), win->h(), cx0, cy0, cx1, cy1 );
+
+        int cmax = 1;
+        for( int cy=cy0; cy<=cy1; cy++ )
+            for( int cx=cx0; cx<=cx1; cx++ )
+                cmax = std::max( cmax, lv.count[ cy*lv.w+cx ] );
+
+        float lnorm = 1.0f / log( 1.0f + cmax );
+        float rmax  = 0.5f * lsz / view.scale;
+
+        win->set_thickness( -1 );
+        for( int cy=cy0; cy<=cy1; cy++ ) {
+            for( int cx=cx0; cx<=cx1; cx++ ) {
+                int c = cy*lv.w + cx;
+                int n = lv.count[c];
+                if( n == 0 ) continue;
+                double dx, dy;
+                view.image_to_display( lv.sx[c]/n, lv.sy[c]/n, dx, dy );
+                float t = 0.3f + 0.7f * log( 1.0f + n ) * lnorm;
+                win->set_color( uchar(color.r*t), uchar(color.g*t), uchar(color.b*t) );
+                float r = std::min( rmax, 1.0f + sqrtf( (float)n ) );
+                win->draw_circle( (int)dx, (int)dy, (int)(r+0.5f) );
+            }
+        }
+    }
+
+}
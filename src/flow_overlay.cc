@@ -0,0 +1,330 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/flow_overlay.h"
+#include "kortex/gui_window.h"
+#include "kortex/view_transform.h"
+#include <kortex/image.h>
+#include <kortex/check.h>
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef WITH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace kortex {
+
+    namespace {
+        const float pi_f = 3.14159265358979f;
+
+        // atan2 through a minimax polynomial on [0,1], |error| < 1e-5 rad.
+        // the sse version below evaluates the same expression.
+        inline float fast_atan2( float y, float x ) {
+            float ax = fabs( x ), ay = fabs( y );
+            float a  = std::min( ax, ay ) / std::max( std::max( ax, ay ), 1e-30f );
+            float s  = a*a;
+            float r  = ( ( -0.0464964749f*s + 0.15931422f )*s - 0.327622764f )*s*a + a;
+            if( ay > ax )  r = 0.5f*pi_f - r;
+            if( x < 0.0f ) r = pi_f - r;
+            if( y < 0.0f ) r = -r;
+            return r;
+        }
+
+        inline float clamp01( float v ) { return std::min( 1.0f, std::max( 0.0f, v ) ); }
+
+        // hue h in [0,6] and saturation s -> value 1 rgb
+        inline void flow_color( float u, float v, float inv_max, uchar* rgb ) {
+            if( u != u || v != v ) {
+                rgb[0] = rgb[1] = rgb[2] = 0;
+                return;
+            }
+            float s = std::min( 1.0f, sqrtf( u*u + v*v ) * inv_max );
+            float h = ( fast_atan2( v, u ) / pi_f + 1.0f ) * 3.0f;
+            float c[3] = { clamp01( fabs( h-3.0f ) - 1.0f ),
+                           clamp01( 2.0f - fabs( h-2.0f ) ),
+                           clamp01( 2.0f - fabs( h-4.0f ) ) };
+            for( int k=0; k<3; k++ )
+                rgb[k] = (uchar)( 255.0f*( 1.0f - s*( 1.0f-c[k] ) ) + 0.5f );
+        }
+
+#ifdef WITH_SSE
+        inline __m128 select_ps( __m128 m, __m128 a, __m128 b ) {
+            return _mm_or_ps( _mm_and_ps( m, a ), _mm_andnot_ps( m, b ) );
+        }
+
+        inline __m128 abs_ps( __m128 x ) {
+            return _mm_andnot_ps( _mm_set1_ps( -0.0f ), x );
+        }
+
+        inline __m128 atan2_ps( __m128 y, __m128 x ) {
+            __m128 ax = abs_ps( x ), ay = abs_ps( y );
+            __m128 a  = _mm_div_ps( _mm_min_ps( ax, ay ), _mm_max_ps( _mm_max_ps( ax, ay ), _mm_set1_ps( 1e-30f ) ) );
+            __m128 s  = _mm_mul_ps( a, a );
+            __m128 r  = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( -0.0464964749f ), s ), _mm_set1_ps( 0.15931422f ) );
+            r = _mm_sub_ps( _mm_mul_ps( r, s ), _mm_set1_ps( 0.327622764f ) );
+            r = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( r, s ), a ), a );
+            r = select_ps( _mm_cmpgt_ps( ay, ax ), _mm_sub_ps( _mm_set1_ps( 0.5f*pi_f ), r ), r );
+            r = select_ps( _mm_cmplt_ps( x, _mm_setzero_ps() ), _mm_sub_ps( _mm_set1_ps( pi_f ), r ), r );
+            // copy the sign of y, keeping +pi for y == -0.0 out of it
+            __m128 neg = _mm_cmplt_ps( y, _mm_setzero_ps() );
+            return _mm_xor_ps( r, _mm_and_ps( neg, _mm_set1_ps( -0.0f ) ) );
+        }
+
+        inline __m128 clamp01_ps( __m128 v ) {
+            return _mm_min_ps( _mm_max_ps( v, _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) );
+        }
+#endif
+
+        float max_magnitude( const float* u, const float* v, int n ) {
+            float m = 0.0f;
+            for( int i=0; i<n; i++ ) {
+                float q = u[i]*u[i] + v[i]*v[i];
+                if( q > m ) m = q;   // skips nans
+            }
+            return sqrtf( m );
+        }
+    }
+
+    void flow_color_row( const float* u, const float* v, int n, float max_mag, uchar* rgb ) {
+        float inv_max = ( max_mag > 0.0f ) ? 1.0f/max_mag : 0.0f;
+        int i = 0;
+#ifdef WITH_SSE
+        __m128 vinv  = _mm_set1_ps( inv_max );
+        __m128 one   = _mm_set1_ps( 1.0f );
+        __m128 two   = _mm_set1_ps( 2.0f );
+        __m128 three = _mm_set1_ps( 3.0f );
+        __m128 four  = _mm_set1_ps( 4.0f );
+        __m128 k255  = _mm_set1_ps( 255.0f );
+        __m128 half  = _mm_set1_ps( 0.5f );
+        __m128 ipi   = _mm_set1_ps( 1.0f/pi_f );
+        int    c[3][4];
+        for( ; i+4<=n; i+=4 ) {
+            __m128 x  = _mm_loadu_ps( u+i );
+            __m128 y  = _mm_loadu_ps( v+i );
+            __m128 ok = _mm_cmpord_ps( x, y );
+            __m128 s  = _mm_min_ps( _mm_mul_ps( _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ) ), vinv ), one );
+            __m128 h  = _mm_mul_ps( _mm_add_ps( _mm_mul_ps( atan2_ps( y, x ), ipi ), one ), three );
+            __m128 cr = clamp01_ps( _mm_sub_ps( abs_ps( _mm_sub_ps( h, three ) ), one ) );
+            __m128 cg = clamp01_ps( _mm_sub_ps( two, abs_ps( _mm_sub_ps( h, two  ) ) ) );
+            __m128 cb = clamp01_ps( _mm_sub_ps( two, abs_ps( _mm_sub_ps( h, four ) ) ) );
+            // 255*( 1 - s*(1-c) ), zero for nans
+            __m128 ch[3] = { cr, cg, cb };
+            for( int k=0; k<3; k++ ) {
+                __m128 o = _mm_mul_ps( _mm_sub_ps( one, _mm_mul_ps( s, _mm_sub_ps( one, ch[k] ) ) ), k255 );
+                o = _mm_and_ps( _mm_add_ps( o, half ), ok );
+                _mm_storeu_si128( (__m128i*)c[k], _mm_cvttps_epi32( o ) );
+            }
+            uchar* d = rgb + 3*i;
+            for( int j=0; j<4; j++ ) {
+                d[3*j+0] = (uchar)c[0][j];
+                d[3*j+1] = (uchar)c[1][j];
+                d[3*j+2] = (uchar)c[2][j];
+            }
+        }
+#endif
+        for( ; i<n; i++ )
+            flow_color( u[i], v[i], inv_max, rgb+3*i );
+    }
+
+    void flow_to_color( const Image* u, const Image* v, float max_mag, Image* out ) {
+        assert_pointer( u && v && out );
+        u->passert_type( IT_F_GRAY );
+        v->passert_type( IT_F_GRAY );
+        passert_statement( u->w() == v->w() && u->h() == v->h(), "dimension mismatch" );
+
+        int w = u->w();
+        int h = u->h();
+        if( max_mag <= 0.0f ) {
+            float m = 0.0f;
+#pragma omp parallel
+            {
+                float tm = 0.0f;
+#pragma omp for
+                for( int y=0; y<h; y++ )
+                    tm = std::max( tm, max_magnitude( u->get_row_f(y), v->get_row_f(y), w ) );
+#pragma omp critical
+                m = std::max( m, tm );
+            }
+            max_mag = m;
+        }
+
+        out->create( w, h, IT_U_PRGB );
+#pragma omp parallel for
+        for( int y=0; y<h; y++ )
+            flow_color_row( u->get_row_f(y), v->get_row_f(y), w, max_mag, out->get_row_u(y) );
+    }
+
+    FlowOverlay::FlowOverlay() {
+        fu = fv = NULL;
+        fw = fh = fstride = 0;
+        mode        = FLOW_QUIVER;
+        spacing     = 16;
+        arrow_scale = 1.0f;
+        max_mag     = 0.0f;
+        color       = Color( 0, 255, 0 );
+        hsv_dw = hsv_dh = 0;
+        hsv_x  = hsv_y  = hsv_w = hsv_h = 0;
+        hsv_valid   = false;
+    }
+
+    void FlowOverlay::set_flow( const float* u, const float* v, int w, int h, int stride ) {
+        passert_statement( w >= 0 && h >= 0 && stride >= 0, "invalid flow dimensions" );
+        fu = u;
+        fv = v;
+        fw = w;
+        fh = h;
+        fstride = stride ? stride : w;
+        hsv_valid = false;
+    }
+
+    void FlowOverlay::set_flow( const Image* u, const Image* v ) {
+        assert_pointer( u && v );
+        u->passert_type( IT_F_GRAY );
+        v->passert_type( IT_F_GRAY );
+        passert_statement( u->w() == v->w() && u->h() == v->h(), "dimension mismatch" );
+        int stride = ( u->h() > 1 ) ? int( u->get_row_f(1) - u->get_row_f(0) ) : u->w();
+        passert_statement( v->h() <= 1 || v->get_row_f(1) - v->get_row_f(0) == stride, "u and v strides differ" );
+        set_flow( u->get_row_f(0), v->get_row_f(0), u->w(), u->h(), stride );
+    }
+
+    void FlowOverlay::draw( GUIWindow* win, const ViewTransform& view ) const {
+        assert_pointer( win );
+        if( !fu || !fv || fw == 0 || fh == 0 ) return;
+        if( mode == FLOW_HSV || mode == FLOW_HSV_QUIVER ) draw_hsv( win, view );
+        if( mode == FLOW_QUIVER || mode == FLOW_HSV_QUIVER ) {
+            int thickness = win->get_thickness();
+            draw_quiver( win, view );
+            win->set_thickness( thickness );
+        }
+    }
+
+    // the grid is anchored to image pixels so arrows stay put while
+    // panning; its step is spacing display pixels in image units
+    void FlowOverlay::draw_quiver( GUIWindow* win, const ViewTransform& view ) const {
+        passert_statement( spacing >= 1, "invalid arrow spacing" );
+        int dw = win->w();
+        int dh = win->h();
+
+        int step = std::max( 1, (int)floor( spacing*view.scale + 0.5 ) );
+        double ix0, iy0, ix1, iy1;
+        view.visible_region( dw, dh, ix0, iy0, ix1, iy1 );
+        int gx0 = std::max( 0, (int)floor( ix0/step ) ), gx1 = std::min( (fw-1)/step, (int)floor( ix1/step ) );
+        int gy0 = std::max( 0, (int)floor( iy0/step ) ), gy1 = std::min( (fh-1)/step, (int)floor( iy1/step ) );
+
+        const float ca = cosf( 0.45f ), sa = sinf( 0.45f );
+        float  inv_scale = float( 1.0/view.scale );
+        float  max_head  = 0.4f*spacing;
+
+        arrow_xy.clear();
+        arrow_n.clear();
+        for( int gy=gy0; gy<=gy1; gy++ ) {
+            int iy = std::min( fh-1, gy*step + step/2 );
+            const float* urow = fu + size_t(iy)*fstride;
+            const float* vrow = fv + size_t(iy)*fstride;
+            float by = float( ( iy+0.5 - view.y0 ) * inv_scale );
+            for( int gx=gx0; gx<=gx1; gx++ ) {
+                int   ix = std::min( fw-1, gx*step + step/2 );
+                float du = urow[ix] * arrow_scale * inv_scale;
+                float dv = vrow[ix] * arrow_scale * inv_scale;
+                float len2 = du*du + dv*dv;
+                if( !( len2 >= 1.0f ) ) continue;   // sub-pixel arrows and nans
+                float len = sqrtf( len2 );
+                float bx  = float( ( ix+0.5 - view.x0 ) * inv_scale );
+                float ex  = bx + du, ey = by + dv;
+                float hl  = std::min( 0.35f*len, max_head ) / len;
+                float hx  = -du*hl, hy = -dv*hl;
+                int p[10] = { int( bx+0.5f ), int( by+0.5f ),
+                              int( ex+0.5f ), int( ey+0.5f ),
+                              int( ex + ca*hx - sa*hy + 0.5f ), int( ey + sa*hx + ca*hy + 0.5f ),
+                              int( ex+0.5f ), int( ey+0.5f ),
+                              int( ex + ca*hx + sa*hy + 0.5f ), int( ey - sa*hx + ca*hy + 0.5f ) };
+                arrow_xy.insert( arrow_xy.end(), p, p+10 );
+                arrow_n.push_back( 5 );
+            }
+        }
+        if( arrow_n.empty() ) return;
+        win->set_color( color );
+        win->set_thickness( 1 );
+        win->draw_polylines( &arrow_xy[0], &arrow_n[0], (int)arrow_n.size() );
+    }
+
+    // the colored field is rebuilt only when the view changes so that a
+    // redraw costs one image paint
+    void FlowOverlay::draw_hsv( GUIWindow* win, const ViewTransform& view ) const {
+        int dw = win->w();
+        int dh = win->h();
+        if( !hsv_valid || hsv_view != view || hsv_dw != dw || hsv_dh != dh )
+            build_hsv( view, dw, dh );
+        if( hsv_w <= 0 || hsv_h <= 0 ) return;
+        win->draw_image( &rgb[0], NULL, hsv_x, hsv_y, hsv_w, hsv_h );
+    }
+
+    // nearest sampling of the flow at the display pixels that cover the
+    // field, colored row by row
+    void FlowOverlay::build_hsv( const ViewTransform& view, int dw, int dh ) const {
+        hsv_view  = view;
+        hsv_dw    = dw;
+        hsv_dh    = dh;
+        hsv_valid = true;
+
+        int dx0 = std::max( 0,  (int)ceil ( ( 0  - view.x0 )/view.scale - 0.5 ) );
+        int dx1 = std::min( dw, (int)ceil ( ( fw - view.x0 )/view.scale - 0.5 ) );
+        int dy0 = std::max( 0,  (int)ceil ( ( 0  - view.y0 )/view.scale - 0.5 ) );
+        int dy1 = std::min( dh, (int)ceil ( ( fh - view.y0 )/view.scale - 0.5 ) );
+        int pw = dx1-dx0;
+        int ph = dy1-dy0;
+        hsv_x = dx0;
+        hsv_y = dy0;
+        hsv_w = pw;
+        hsv_h = ph;
+        if( pw <= 0 || ph <= 0 ) return;
+
+        vector<int> xmap( pw );
+        for( int x=0; x<pw; x++ )
+            xmap[x] = std::min( fw-1, std::max( 0, (int)floor( view.x0 + (dx0+x+0.5)*view.scale ) ) );
+
+        su.resize( size_t(pw)*ph );
+        sv.resize( size_t(pw)*ph );
+        rgb.resize( 3*size_t(pw)*ph );
+
+        float m = 0.0f;
+#pragma omp parallel
+        {
+            float tm = 0.0f;
+#pragma omp for
+            for( int y=0; y<ph; y++ ) {
+                int iy = std::min( fh-1, std::max( 0, (int)floor( view.y0 + (dy0+y+0.5)*view.scale ) ) );
+                const float* urow = fu + size_t(iy)*fstride;
+                const float* vrow = fv + size_t(iy)*fstride;
+                float* pu = &su[ size_t(y)*pw ];
+                float* pv = &sv[ size_t(y)*pw ];
+                for( int x=0; x<pw; x++ ) {
+                    pu[x] = urow[ xmap[x] ];
+                    pv[x] = vrow[ xmap[x] ];
+                }
+                if( max_mag <= 0.0f )
+                    tm = std::max( tm, max_magnitude( pu, pv, pw ) );
+            }
+#pragma omp critical
+            m = std::max( m, tm );
+        }
+        float mm = ( max_mag > 0.0f ) ? max_mag : m;
+
+#pragma omp parallel for
+        for( int y=0; y<ph; y++ )
+            flow_color_row( &su[ size_t(y)*pw ], &sv[ size_t(y)*pw ], pw, mm, &rgb[ 3*size_t(y)*pw ] );
+    }
+
+}
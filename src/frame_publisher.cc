@@ -0,0 +1,269 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/frame_publisher.h"
+#include "kortex/display_list.h"
+#include <kortex/image.h>
+#include <kortex/check.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace kortex {
+
+    namespace {
+        const char   ring_magic[8] = { 'K','F','R','I','N','G','0','1' };
+        const size_t ring_header   = 4096;   // bytes before the first slot
+        const size_t slot_header   = 128;    // bytes before the data of a slot
+
+        // the ring header and the slot headers live in the shared mapping.
+        // std::atomic<uint64_t> is lock-free and address-free here.
+        struct RingHeader {
+            char     magic[8];
+            uint32_t no_slots;
+            uint32_t reserved;
+            uint64_t slot_stride;
+            uint64_t max_bytes;
+            uint64_t max_overlay_bytes;
+            std::atomic<uint64_t> latest;    // id of the newest complete frame, 0 if none
+        };
+
+        struct SlotHeader {
+            std::atomic<uint64_t> seq;       // 2*id-1 while frame id is written, 2*id after
+            int32_t  w, h, type, precision;
+            int32_t  ow, oh;                 // size of the overlay display list
+            uint64_t image_bytes;
+            uint64_t overlay_bytes;
+            double   time;
+        };
+
+        inline size_t round_up( size_t v, size_t a ) { return ( v + a-1 ) / a * a; }
+
+        inline size_t row_bytes( const Image* im ) {
+            return size_t( im->w() ) * im->ch() * ( im->precision() == TYPE_UCHAR ? 1 : sizeof(float) );
+        }
+
+        inline const uchar* row_ptr( const Image* im, int y ) {
+            if( im->precision() == TYPE_UCHAR ) return im->get_row_u( y );
+            return (const uchar*)im->get_row_f( y );
+        }
+
+        inline uchar* row_ptr( Image* im, int y ) {
+            if( im->precision() == TYPE_UCHAR ) return im->get_row_u( y );
+            return (uchar*)im->get_row_f( y );
+        }
+
+        inline RingHeader* ring( void* base ) { return (RingHeader*)base; }
+
+        inline SlotHeader* slot( void* base, uint64_t id ) {
+            const RingHeader* r = ring( base );
+            return (SlotHeader*)( (uchar*)base + ring_header + ( id % r->no_slots ) * r->slot_stride );
+        }
+
+        inline uchar* slot_data( SlotHeader* s ) { return (uchar*)s + slot_header; }
+
+        string shm_name( const string& name ) {
+            return name.size() && name[0] == '/' ? name : "/" + name;
+        }
+    }
+
+    FramePublisher::FramePublisher() {
+        fd    = -1;
+        base  = NULL;
+        bytes = 0;
+        frame = 0;
+    }
+
+    FramePublisher::~FramePublisher() {
+        destroy();
+    }
+
+    void FramePublisher::create( const string& name, size_t max_bytes, size_t max_overlay_bytes, int no_slots ) {
+        passert_statement( no_slots >= 2, "the ring needs at least two slots" );
+        destroy();
+        sname = shm_name( name );
+
+        size_t stride = slot_header + round_up( max_bytes + max_overlay_bytes, 64 );
+        bytes = ring_header + stride * no_slots;
+
+        fd = shm_open( sname.c_str(), O_CREAT | O_RDWR, 0644 );
+        passert_statement( fd >= 0, "could not create shared memory" );
+        passert_statement( ftruncate( fd, bytes ) == 0, "could not size shared memory" );
+        base = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+        passert_statement( base != MAP_FAILED, "could not map shared memory" );
+
+        // readers check the magic last, so it is written after the layout
+        RingHeader* r = ring( base );
+        memset( base, 0, ring_header );
+        r->no_slots          = no_slots;
+        r->slot_stride       = stride;
+        r->max_bytes         = max_bytes;
+        r->max_overlay_bytes = max_overlay_bytes;
+        r->latest.store( 0, std::memory_order_relaxed );
+        for( int k=0; k<no_slots; k++ )
+            slot( base, k )->seq.store( 0, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+        memcpy( r->magic, ring_magic, 8 );
+        frame = 0;
+    }
+
+    void FramePublisher::destroy() {
+        if( base ) munmap( base, bytes );
+        if( fd >= 0 ) {
+            ::close( fd );
+            shm_unlink( sname.c_str() );
+        }
+        fd    = -1;
+        base  = NULL;
+        bytes = 0;
+    }
+
+    void FramePublisher::publish( const Image* im, const DisplayList* overlay ) {
+        assert_pointer( im && base );
+        RingHeader* r = ring( base );
+
+        size_t rb = row_bytes( im );
+        size_t ib = rb * im->h();
+        size_t ob = overlay ? overlay->size_in_bytes() : 0;
+        passert_statement( ib <= r->max_bytes,         "frame is larger than the ring slots" );
+        passert_statement( ob <= r->max_overlay_bytes, "overlay is larger than the ring slots" );
+
+        uint64_t    id = ++frame;
+        SlotHeader* s  = slot( base, id );
+        s->seq.store( 2*id-1, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+
+        s->w             = im->w();
+        s->h             = im->h();
+        s->type          = im->type();
+        s->precision     = im->precision();
+        s->image_bytes   = ib;
+        s->overlay_bytes = ob;
+        s->ow            = overlay ? overlay->w() : 0;
+        s->oh            = overlay ? overlay->h() : 0;
+        s->time          = std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+
+        uchar* dst = slot_data( s );
+        for( int y=0; y<im->h(); y++ )
+            memcpy( dst + y*rb, row_ptr( im, y ), rb );
+        if( ob ) memcpy( dst + ib, overlay->data(), ob );
+
+        s->seq.store( 2*id, std::memory_order_release );
+        r->latest.store( id, std::memory_order_release );
+    }
+
+    FrameSubscriber::FrameSubscriber() {
+        fd       = -1;
+        base     = NULL;
+        bytes    = 0;
+        last     = 0;
+        nskipped = 0;
+    }
+
+    FrameSubscriber::~FrameSubscriber() {
+        close();
+    }
+
+    bool FrameSubscriber::open( const string& name ) {
+        close();
+        fd = shm_open( shm_name( name ).c_str(), O_RDONLY, 0 );
+        if( fd < 0 ) return false;
+
+        struct stat st;
+        if( fstat( fd, &st ) != 0 || (size_t)st.st_size < ring_header ) {
+            close();
+            return false;
+        }
+        bytes = st.st_size;
+        base  = mmap( NULL, bytes, PROT_READ, MAP_SHARED, fd, 0 );
+        if( base == MAP_FAILED ) {
+            base = NULL;
+            close();
+            return false;
+        }
+        const RingHeader* r = ring( base );
+        if( memcmp( r->magic, ring_magic, 8 ) || r->no_slots < 2 ||
+            ring_header + r->no_slots * r->slot_stride > bytes ) {
+            close();
+            return false;
+        }
+        std::atomic_thread_fence( std::memory_order_acquire );
+        last = 0;
+        return true;
+    }
+
+    void FrameSubscriber::close() {
+        if( base ) munmap( base, bytes );
+        if( fd >= 0 ) ::close( fd );
+        fd    = -1;
+        base  = NULL;
+        bytes = 0;
+    }
+
+    // seqlock read: the copy is kept only if the slot sequence did not
+    // change while copying; otherwise the producer lapped us and the newest
+    // frame is tried again.
+    bool FrameSubscriber::latest( Image* im, DisplayList* overlay ) {
+        assert_pointer( im );
+        if( !base ) return false;
+        RingHeader* r = ring( base );
+
+        vector<uchar> obuf;
+        for( int tries=0; tries<8; tries++ ) {
+            uint64_t id = r->latest.load( std::memory_order_acquire );
+            if( id == 0 || id == last ) return false;
+
+            SlotHeader* s  = slot( base, id );
+            uint64_t    s0 = s->seq.load( std::memory_order_acquire );
+            if( s0 != 2*id ) continue;
+
+            int      w  = s->w;
+            int      h  = s->h;
+            int      t  = s->type;
+            uint64_t ib = s->image_bytes;
+            uint64_t ob = s->overlay_bytes;
+            int      ow = s->ow, oh = s->oh;
+            if( ib > r->max_bytes || ob > r->max_overlay_bytes || h <= 0 || ib % h ) continue;
+
+            if( im->w() != w || im->h() != h || im->type() != (ImageType)t )
+                im->create( w, h, (ImageType)t );
+            size_t rb = ib / h;
+            if( rb != row_bytes( im ) ) continue;
+
+            const uchar* src = slot_data( s );
+            for( int y=0; y<h; y++ )
+                memcpy( row_ptr( im, y ), src + y*rb, rb );
+            if( overlay ) obuf.assign( src + ib, src + ib + ob );
+
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if( s->seq.load( std::memory_order_relaxed ) != s0 ) continue;
+
+            if( last && id > last+1 ) nskipped += id-last-1;
+            last = id;
+            if( overlay ) {
+                if( ob ) overlay->assign( ow, oh, obuf.data(), obuf.size() );
+                else     overlay->clear();
+            }
+            return true;
+        }
+        return false;
+    }
+
+}
@@ -15,12 +15,26 @@
 
 #include "kortex/gui_window.h"
 #include "kortex/opencv_extensions.h"
+#include "kortex/input_log.h"
+#include "kortex/display_list.h"
+#include "kortex/buffer_pool.h"
 #include <kortex/image.h>
 #include <kortex/string.h>
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <atomic>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 using namespace std;
 
 namespace kortex {
@@ -36,6 +50,97 @@ namespace kortex {
         }
     }
 
+    namespace {
+        // 8 bit binary pgm (P5) / ppm (P6)
+        struct PnmInfo {
+            int    w, h, nc;
+            size_t offset;      // first pixel byte
+        };
+
+        bool pnm_token( const uchar* p, size_t n, size_t& i, int& v ) {
+            while( i < n ) {
+                if( p[i] == '#' ) { while( i < n && p[i] != '\n' ) i++; }
+                else if( isspace( p[i] ) ) i++;
+                else break;
+            }
+            if( i >= n || !isdigit( p[i] ) ) return false;
+            v = 0;
+            while( i < n && isdigit( p[i] ) && v < ( 1<<24 ) )
+                v = 10*v + ( p[i++] - '0' );
+            return true;
+        }
+
+        bool parse_pnm( const uchar* p, size_t n, PnmInfo& info ) {
+            if( n < 2 || p[0] != 'P' || ( p[1] != '5' && p[1] != '6' ) ) return false;
+            info.nc = ( p[1] == '5' ) ? 1 : 3;
+            size_t i = 2;
+            int maxval;
+            if( !pnm_token( p, n, i, info.w ) || !pnm_token( p, n, i, info.h ) ||
+                !pnm_token( p, n, i, maxval ) || maxval != 255 ) return false;
+            if( i >= n || !isspace( p[i] ) ) return false;
+            info.offset = i+1;
+            return info.w > 0 && info.h > 0 &&
+                info.offset + size_t( info.w ) * info.h * info.nc <= n;
+        }
+
+        // maps file if it is a raw pnm the display can take directly
+        bool map_pnm( const string& file, void*& map, size_t& bytes, PnmInfo& info ) {
+            map = NULL;
+            int fd = open( file.c_str(), O_RDONLY );
+            if( fd < 0 ) return false;
+            struct stat st;
+            if( fstat( fd, &st ) == 0 && st.st_size > 2 ) {
+                bytes = st.st_size;
+                map   = mmap( NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0 );
+                if( map == MAP_FAILED ) map = NULL;
+            }
+            close( fd );
+            if( map && parse_pnm( (const uchar*)map, bytes, info ) ) {
+                madvise( map, bytes, MADV_SEQUENTIAL );
+                return true;
+            }
+            if( map ) munmap( map, bytes );
+            map = NULL;
+            return false;
+        }
+
+        void convert_pnm_rows( const uchar* data, const PnmInfo& info, int y0, int y1, IplImage* dst ) {
+            for( int y=y0; y<y1; y++ ) {
+                const uchar* src = data + info.offset + size_t(y)*info.w*info.nc;
+                uchar*       row = (uchar*)( dst->imageData + y*dst->widthStep );
+                if( info.nc == 1 ) {
+                    for( int x=0; x<info.w; x++ )
+                        row[3*x+0] = row[3*x+1] = row[3*x+2] = src[x];
+                } else {
+                    for( int x=0; x<info.w; x++ ) {
+                        row[3*x+0] = src[3*x+2];
+                        row[3*x+1] = src[3*x+1];
+                        row[3*x+2] = src[3*x+0];
+                    }
+                }
+            }
+        }
+
+        const int pnm_rows_per_step = 64;
+    }
+
+    // state of a load running on a worker thread. the worker only writes
+    // into buffers owned by the load: a mapped pnm is converted row by row
+    // into rows_buf, which poll_image copies to original_display on the
+    // ui thread; other formats are decoded into result which replaces
+    // original_display once done.
+    struct GUIWindow::AsyncLoad {
+        std::thread       worker;
+        std::atomic<int>  rows;
+        std::atomic<bool> done;
+        std::atomic<bool> cancel;
+        int               shown;
+        IplImage*         rows_buf;
+        IplImage*         result;
+        void*             map;
+        size_t            map_bytes;
+    };
+
     void GUIWindow::init_() {
         display          = NULL;
         original_display = NULL;
@@ -52,10 +157,20 @@ namespace kortex {
 
     GUIWindow::GUIWindow() {
         wname = "float window";
+        async     = NULL;
+        bheadless = false;
+        mouse     = &g_mouse_callback;
+        session   = NULL;
+        dlist     = NULL;
         init_();
     }
     GUIWindow::GUIWindow(const string& name) {
         wname = name;
+        async     = NULL;
+        bheadless = false;
+        mouse     = &g_mouse_callback;
+        session   = NULL;
+        dlist     = NULL;
         init_();
     }
 
@@ -64,39 +179,98 @@ namespace kortex {
     }
 
     void GUIWindow::create(const int& fixed) {
+        if( bheadless ) return;
         cvStartWindowThread();
         cvNamedWindow(wname.c_str(), fixed);
     }
 
     void GUIWindow::destroy() {
+        if( bheadless ) return;
         cvDestroyWindow(wname.c_str());
         cvWaitKey(50);
     }
 
+    // the freed display buffers are not kept for windows that may never
+    // come back
     GUIWindow::~GUIWindow() {
         reset();
+        delete session;
+        buffer_pool().trim();
+    }
+
+    // headless windows keep their own mouse state so that replayed input
+    // does not leak into the real windows
+    void GUIWindow::set_headless( bool state ) {
+        bheadless = state;
+        if( bheadless ) {
+            local_mouse = g_mouse_callback;
+            local_mouse.x = local_mouse.y = -1;
+            local_mouse.event = -1;
+            mouse = &local_mouse;
+        } else {
+            mouse = &g_mouse_callback;
+        }
+    }
+
+    void GUIWindow::record_input( InputLog* log ) {
+        if( !session ) session = new InputSession();
+        session->record( log );
+    }
+
+    void GUIWindow::replay_input( const InputLog* log, ReplayStats* stats ) {
+        set_headless( true );
+        if( !session ) session = new InputSession();
+        session->replay( log, stats );
+    }
+
+    void GUIWindow::record_display( DisplayList* dl ) {
+        dlist = dl;
+        if( !dlist ) return;
+        dlist->begin( dw, dh );
+        dlist->set_color( dp_color );
+        dlist->set_thickness( dp_thickness );
+        dlist->set_font( dp_font->hscale, dp_font->vscale, dp_font->shear, dp_font->thickness );
     }
 
     void GUIWindow::init(const int& w, const int& h, const int& nc) {
-        if( original_display ) cvReleaseImage( &original_display );
+        cancel_load();
+        release_pooled_image( &original_display );
         dh=h;
         dw=w;
-        original_display = cvCreateImage(cvSize(dw,dh), IPL_DEPTH_8U, 3);
+        original_display = create_pooled_image( dw, dh, 3 );
         memset(original_display->imageData, 0, sizeof(uchar)*(original_display->widthStep*h));
         reset_display();
     }
 
     void GUIWindow::create_display(const int& w, const int& h) {
-        if( original_display ) cvReleaseImage( &original_display );
+        cancel_load();
+        release_pooled_image( &original_display );
         dh = h;
         dw = w;
-        original_display = cvCreateImage( cvSize(dw,dh), IPL_DEPTH_8U, 3);
+        original_display = create_pooled_image( dw, dh, 3 );
         cvSet(original_display, cvScalar(0,0,0));
         reset_display();
     }
 
     void GUIWindow::set_image( const string& imname ) {
-        if( original_display ) cvReleaseImage( &original_display );
+        cancel_load();
+        release_pooled_image( &original_display );
+
+        void*   map;
+        size_t  bytes;
+        PnmInfo info;
+        if( map_pnm( imname, map, bytes, info ) ) {
+            dw = info.w;
+            dh = info.h;
+            original_display = create_pooled_image( dw, dh, 3 );
+#pragma omp parallel for schedule(static)
+            for( int y=0; y<dh; y+=pnm_rows_per_step )
+                convert_pnm_rows( (const uchar*)map, info, y, std::min( dh, y+pnm_rows_per_step ), original_display );
+            munmap( map, bytes );
+            reset_display();
+            return;
+        }
+
         Image tmp;
         tmp.load(imname.c_str());
 
@@ -106,30 +280,166 @@ namespace kortex {
     }
 
     void GUIWindow::set_image( const uchar* im, const int& w, const int& h, const int& nc ) {
-        if( original_display ) cvReleaseImage( &original_display );
+        cancel_load();
+        release_pooled_image( &original_display );
         dh = h;
         dw = w;
-        original_display = cvCreateImageHeader( cvSize(dw,dh), IPL_DEPTH_8U, 3);
-        cvCreateData(original_display);
+        original_display = create_pooled_image( dw, dh, 3 );
         copy_image_to_color_ipl(im, dw, dh, nc, original_display);
         reset_display();
     }
     void GUIWindow::set_image( const Image *im ) {
         im->passert_type( IT_U_GRAY | IT_U_PRGB );
-        if( original_display ) cvReleaseImage( &original_display );
+        cancel_load();
+        release_pooled_image( &original_display );
         dh = im->h();
         dw = im->w();
-        original_display = cvCreateImageHeader( cvSize(dw,dh), IPL_DEPTH_8U, 3);
-
-        cvCreateData(original_display);
+        original_display = create_pooled_image( dw, dh, 3 );
         copy_image_to_color_ipl(im, original_display);
         reset_display();
     }
 
+    // fused path used by the low-memory viewer: the source is mapped straight
+    // into original_display. single channel sources may be kept as 1
+    // channel, they are expanded to color only when the display is reset.
+    // factor > 1 area-averages the source down to a window sized display.
+    void GUIWindow::set_image( const Image* im, float vmin, float vmax, bool single_channel, int factor ) {
+        assert_pointer( im );
+        passert_statement( factor >= 1, "invalid downsampling factor" );
+        cancel_load();
+        release_pooled_image( &original_display );
+        release_pooled_image( &display );
+        dh = ( im->h() + factor-1 ) / factor;
+        dw = ( im->w() + factor-1 ) / factor;
+        int nc = ( single_channel && im->ch() == 1 ) ? 1 : 3;
+        original_display = create_pooled_image( dw, dh, nc );
+        if( factor == 1 ) copy_image_to_ipl      ( im,         vmin, vmax, original_display );
+        else              downsample_image_to_ipl( im, factor, vmin, vmax, original_display );
+        reset_display();
+    }
+
+    void GUIWindow::set_image_async( const string& imname ) {
+        cancel_load();
+        AsyncLoad* a = new AsyncLoad();
+        a->rows   = 0;
+        a->done   = false;
+        a->cancel = false;
+        a->shown  = 0;
+        a->rows_buf = NULL;
+        a->result = NULL;
+        a->map    = NULL;
+        a->map_bytes = 0;
+
+        PnmInfo info;
+        if( map_pnm( imname, a->map, a->map_bytes, info ) ) {
+            release_pooled_image( &original_display );
+            dw = info.w;
+            dh = info.h;
+            original_display = create_pooled_image( dw, dh, 3 );
+            cvSet( original_display, cvScalar(64,64,64) );
+            a->rows_buf = create_pooled_image( dw, dh, 3 );
+            IplImage* dst = a->rows_buf;
+            a->worker = std::thread( [a,dst,info]() {
+                    for( int y=0; y<info.h && !a->cancel; y+=pnm_rows_per_step ) {
+                        int y1 = std::min( info.h, y+pnm_rows_per_step );
+                        convert_pnm_rows( (const uchar*)a->map, info, y, y1, dst );
+                        a->rows.store( y1, std::memory_order_release );
+                    }
+                    a->done.store( true, std::memory_order_release );
+                } );
+        } else {
+            if( !original_display || original_display->nChannels != 3 ) {
+                release_pooled_image( &original_display );
+                if( dw <= 0 || dh <= 0 ) { dw = 640; dh = 480; }
+                original_display = create_pooled_image( dw, dh, 3 );
+            }
+            cvSet( original_display, cvScalar(64,64,64) );
+            Color col( 255, 255, 255 );
+            write_on_image( original_display, 10, 10, "loading "+imname, &col, dp_font );
+            a->worker = std::thread( [a,imname]() {
+                    Image tmp;
+                    tmp.load( imname.c_str() );
+                    // 8 bit gray and rgb go to the display format in one
+                    // pass, other types are converted to them first
+                    if( tmp.type() != IT_U_PRGB && tmp.type() != IT_U_GRAY ) {
+                        if     ( tmp.ch() == 3 ) tmp.convert( IT_U_PRGB );
+                        else if( tmp.ch() == 1 ) tmp.convert( IT_U_GRAY );
+                    }
+                    if( !a->cancel ) {
+                        IplImage* ipl = create_pooled_image( tmp.w(), tmp.h(), 3 );
+                        copy_image_to_ipl( &tmp, 0.0f, 255.0f, ipl );
+                        a->result = ipl;
+                        a->rows.store( tmp.h(), std::memory_order_release );
+                    }
+                    a->done.store( true, std::memory_order_release );
+                } );
+        }
+        async = a;
+        reset_display();
+    }
+
+    bool GUIWindow::poll_image() {
+        if( !async ) return false;
+        int  r       = async->rows.load( std::memory_order_acquire );
+        bool changed = ( r != async->shown );
+        if( changed && async->rows_buf ) {
+            IplImage* src = async->rows_buf;
+            for( int y=async->shown; y<r; y++ )
+                memcpy( original_display->imageData + y*original_display->widthStep,
+                        src->imageData + y*src->widthStep, 3*src->width );
+        }
+        async->shown = r;
+        if( async->done.load( std::memory_order_acquire ) ) {
+            async->worker.join();
+            if( async->result ) {
+                release_pooled_image( &original_display );
+                original_display = async->result;
+                dw = original_display->width;
+                dh = original_display->height;
+                mouse->xend = dw;
+                mouse->yend = dh;
+            }
+            if( async->rows_buf ) release_pooled_image( &async->rows_buf );
+            if( async->map ) munmap( async->map, async->map_bytes );
+            delete async;
+            async   = NULL;
+            changed = true;
+        }
+        if( changed ) reset_display();
+        return changed;
+    }
+
+    void GUIWindow::cancel_load() {
+        if( !async ) return;
+        async->cancel = true;
+        async->worker.join();
+        if( async->result   ) release_pooled_image( &async->result );
+        if( async->rows_buf ) release_pooled_image( &async->rows_buf );
+        if( async->map      ) munmap( async->map, async->map_bytes );
+        delete async;
+        async = NULL;
+    }
+
+    size_t GUIWindow::memory_usage() const {
+        size_t bytes = 0;
+        if( display          ) bytes += (size_t)display->widthStep          * display->height;
+        if( original_display ) bytes += (size_t)original_display->widthStep * original_display->height;
+        return bytes;
+    }
+
+    size_t GUIWindow::pool_memory_usage() {
+        return buffer_pool().stats().bytes_held;
+    }
+
     void GUIWindow::save_screen( const string& file ) const {
         cvSaveImage( file.c_str(), display );
     }
 
+    void GUIWindow::get_screen( Image* im ) const {
+        assert_pointer( display );
+        copy_ipl_to_image( display, im );
+    }
+
     void GUIWindow::zoom_to_point( const int& x, const int& y, const int& wsz) {
         Image tmp_img;
         copy_ipl_to_image(display, &tmp_img);
@@ -144,6 +454,10 @@ namespace kortex {
         return original_display;
     }
 
+    IplImage* GUIWindow::get_original_display() {
+        return original_display;
+    }
+
     const IplImage* GUIWindow::get_display() const {
         return display;
     }
@@ -155,31 +469,73 @@ namespace kortex {
 
     void GUIWindow::set_original_display(const GUIWindow* src_wnd, const int& x, const int& y, const int& wsz) {
         const IplImage* sdisplay = src_wnd->get_original_display();
+        cancel_load();
         copy_to_color_ipl(sdisplay, x, y, wsz, original_display);
         reset_display();
     }
 
     void GUIWindow::draw_line( int x0, int y0, int x1, int y1) {
+        if( dlist ) dlist->draw_line( x0, y0, x1, y1 );
         kortex::draw_line( display, x0, y0, x1, y1, &dp_color, dp_thickness);
     }
     void GUIWindow::draw_rectangle( int x, int y, int dw, int dh) {
+        if( dlist ) dlist->draw_rectangle( x, y, dw, dh );
         kortex::draw_rectangle( display, x, y, dw, dh, &dp_color, dp_thickness);
     }
     void GUIWindow::draw_circle( int x, int y, int dr ) {
+        if( dlist ) dlist->draw_circle( x, y, dr );
         kortex::draw_circle( display, x, y, dr, &dp_color, dp_thickness);
     }
     void GUIWindow::draw_polygon(int* xy, int no_points ) {
+        if( dlist ) dlist->draw_polygon( xy, no_points );
         kortex::draw_polygon( display, xy, no_points, &dp_color, dp_thickness);
     }
+    void GUIWindow::draw_polylines( const int* xy, const int* counts, int no_lines ) {
+        if( dlist ) dlist->draw_polylines( xy, counts, no_lines );
+        kortex::draw_polylines( display, xy, counts, no_lines, &dp_color, dp_thickness );
+    }
+    // paints iw x ih interleaved rgb pixels with their top-left corner at
+    // (x,y). pixels with a zero mask are left untouched.
+    void GUIWindow::draw_image( const uchar* rgb, const uchar* mask, int x, int y, int iw, int ih ) {
+        assert_pointer( rgb && display );
+        if( dlist ) dlist->draw_image( rgb, mask, x, y, iw, ih );
+        int x0 = std::max( 0, -x ), x1 = std::min( iw, dw-x );
+        int y0 = std::max( 0, -y ), y1 = std::min( ih, dh-y );
+        for( int r=y0; r<y1; r++ ) {
+            uchar*       drow = (uchar*)( display->imageData + (y+r)*display->widthStep );
+            const uchar* srow = rgb + 3*size_t(r)*iw;
+            const uchar* mrow = mask ? mask + size_t(r)*iw : NULL;
+            for( int c=x0; c<x1; c++ ) {
+                if( mrow && !mrow[c] ) continue;
+                uchar* d = drow + 3*(x+c);
+                d[0] = srow[3*c+2];
+                d[1] = srow[3*c+1];
+                d[2] = srow[3*c+0];
+            }
+        }
+    }
     void GUIWindow::draw_ray( int x0, int y0, float length, float angle) {
+        if( dlist ) dlist->draw_ray( x0, y0, length, angle );
         kortex::draw_ray( display, x0, y0, length, angle, &dp_color, dp_thickness);
     }
     void GUIWindow::mark( int x, int y, int thickness ) {
+        if( dlist ) dlist->mark( x, y, thickness == -1 ? dp_thickness : thickness );
         if( thickness == -1 ) kortex::draw_marker( display, x, y, &dp_color, dp_thickness );
         else                  kortex::draw_marker( display, x, y, &dp_color, thickness );
     }
     void GUIWindow::mark_region( int* mark, bool permanent ) {
+        if( dlist ) dlist->mark_region( mark, permanent );
         if( permanent ) {
+            assert_pointer( original_display );
+            cancel_load();
+            // a gray background of the low memory mode is expanded first so
+            // that the region keeps its color
+            if( original_display->nChannels == 1 ) {
+                IplImage* bgr = create_pooled_image( dw, dh, 3 );
+                cvCvtColor( original_display, bgr, CV_GRAY2BGR );
+                release_pooled_image( &original_display );
+                original_display = bgr;
+            }
             overlay_region(original_display, mark);
             reset_display();
         } else {
@@ -187,61 +543,88 @@ namespace kortex {
         }
     }
     void GUIWindow::write(int x, int y, const string& text) {
+        if( dlist ) dlist->write( x, y, text );
         write_on_image(display, x, y, text, &dp_color, dp_font);
     }
     void GUIWindow::write(int x, int y, int num) {
-        string text = num2str(num);
-        write_on_image(display, x, y, text, &dp_color, dp_font);
+        write( x, y, num2str(num) );
     }
     void GUIWindow::write(int x, int y, float num) {
-        string text = num2str(num,8);
-        write_on_image(display, x, y, text, &dp_color, dp_font);
+        write( x, y, num2str(num,8) );
     }
     void GUIWindow::write(int x, int y, double num) {
-        string text = num2str(num,8);
-        write_on_image(display, x, y, text, &dp_color, dp_font);
+        write( x, y, num2str(num,8) );
     }
     void GUIWindow::reset_display() {
-        if( display ) cvReleaseImage(&display);
-        display = cvCloneImage(original_display);
+        if( dlist ) dlist->reset_display();
+        if( display && ( display->width  != original_display->width ||
+                         display->height != original_display->height ) )
+            release_pooled_image( &display );
+        if( !display )
+            display = create_pooled_image( original_display->width, original_display->height, 3 );
+        if( original_display->nChannels == 1 ) cvCvtColor( original_display, display, CV_GRAY2BGR );
+        else                                   cvCopy( original_display, display );
+    }
+
+    void GUIWindow::save_display() {
+        assert_pointer( display && original_display );
+        if( dlist ) dlist->save_display();
+        cancel_load();
+        if( original_display->nChannels == 1 ) {
+            release_pooled_image( &original_display );
+            original_display = create_pooled_image( dw, dh, 3 );
+        }
+        cvCopy( display, original_display );
+    }
+
+    void GUIWindow::clear_display() {
+        assert_pointer( original_display );
+        if( dlist ) dlist->clear_display();
+        cancel_load();
+        cvSet( original_display, cvScalar(0,0,0) );
+        reset_display();
     }
 
     void GUIWindow::reset() {
-        if( display          ) cvReleaseImage(&display);
-        if( original_display ) cvReleaseImage(&original_display);
+        cancel_load();
+        release_pooled_image( &display );
+        release_pooled_image( &original_display );
         if( dp_font          ) { delete dp_font; dp_font = NULL; }
         init_();
     }
 
     void GUIWindow::reset_mouse() {
-        g_mouse_callback.xstart = 0;
-        g_mouse_callback.ystart = 0;
-        g_mouse_callback.xend = dw;
-        g_mouse_callback.yend = dh;
-        g_mouse_callback.x = -1;
-        g_mouse_callback.y = -1;
-        g_mouse_callback.event = -1;
+        mouse->xstart = 0;
+        mouse->ystart = 0;
+        mouse->xend = dw;
+        mouse->yend = dh;
+        mouse->x = -1;
+        mouse->y = -1;
+        mouse->event = -1;
     }
     void GUIWindow::init_mouse() {
         reset_mouse();
+        if( bheadless ) return;
         cvSetMouseCallback(wname.c_str(), mouse_callback, 0 );
     }
     int GUIWindow::wait( const int& ms ) const {
-        return ((cvWaitKey(ms)) & 0xffff);
+        int key = bheadless ? -1 : ((cvWaitKey(ms)) & 0xffff);
+        if( session ) key = session->next_frame( key, *mouse );
+        return key;
     }
     bool GUIWindow::mouse_click( const int& button, int &x, int &y ) const {
-        if( g_mouse_callback.x > 0 && g_mouse_callback.y > 0 && g_mouse_callback.event == button ) {
-            x = g_mouse_callback.x;
-            y = g_mouse_callback.y;
+        if( mouse->x > 0 && mouse->y > 0 && mouse->event == button ) {
+            x = mouse->x;
+            y = mouse->y;
             return true;
         } else {
             return false;
         }
     }
     bool GUIWindow::mouse_move_event(int &x, int &y ) const {
-        if( g_mouse_callback.x > 0 && g_mouse_callback.y > 0 && g_mouse_callback.event == CV_EVENT_MOUSEMOVE ) {
-            x = g_mouse_callback.x;
-            y = g_mouse_callback.y;
+        if( mouse->x > 0 && mouse->y > 0 && mouse->event == CV_EVENT_MOUSEMOVE ) {
+            x = mouse->x;
+            y = mouse->y;
             return true;
         } else {
             return false;
@@ -251,32 +634,42 @@ namespace kortex {
     void GUIWindow::move( const int& x, const int& y ) {
         py = y;
         px = x;
+        if( bheadless ) return;
         cvMoveWindow(wname.c_str(), px, py);
     }
     void GUIWindow::show() {
         assert( wname != "" );
+        if( session ) session->frame_shown( display );
+        if( bheadless ) return;
         cvShowImage( wname.c_str(), display);
     }
     void GUIWindow::refresh() {
+        if( session ) session->frame_shown( display );
+        if( bheadless ) return;
         cvShowImage( wname.c_str(), display);
     }
     void GUIWindow::resize(const int& nw, const int& nh) {
+        if( bheadless ) return;
         cvResizeWindow(wname.c_str(), nw, nh);
     }
     void GUIWindow::set_thickness(const int& t) {
         dp_thickness = t;
+        if( dlist ) dlist->set_thickness( t );
     }
 
     void GUIWindow::set_color( const uchar& r, const uchar& g, const uchar& b ) {
         dp_color = Color(r,g,b);
+        if( dlist ) dlist->set_color( dp_color );
     }
 
     void GUIWindow::set_color( const Color& col ) {
         dp_color = col;
+        if( dlist ) dlist->set_color( dp_color );
     }
 
     void GUIWindow::set_font( float hs, float vs, float shear, float thickness ) {
         cvInitFont(dp_font, CV_FONT_HERSHEY_PLAIN, hs, vs, shear, thickness, CV_AA);
+        if( dlist ) dlist->set_font( hs, vs, shear, thickness );
     }
 }
 #endif
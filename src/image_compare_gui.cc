@@ -0,0 +1,406 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifdef WITH_OPENCV
+
+#include "kortex/image_compare_gui.h"
+#include "kortex/opencv_extensions.h"
+#include <kortex/image.h>
+#include <kortex/string.h>
+
+#include <opencv2/opencv.hpp>
+
+#ifdef WITH_SSE
+#include <emmintrin.h>
+#endif
+
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+
+namespace kortex {
+
+    static const int DIFF_TILE_SIZE      = 64;
+    static const int DIFF_TILE_CACHE_MAX = 1024;
+
+    static int floor_div( long long a, int b ) {
+        return (int)( a >= 0 ? a/b : -((-a+b-1)/b) );
+    }
+
+    static void absdiff_u8( const uchar* a, const uchar* b, uchar* d, int n ) {
+        int i = 0;
+#ifdef WITH_SSE
+        for( ; i+16<=n; i+=16 ) {
+            __m128i va = _mm_loadu_si128( (const __m128i*)(a+i) );
+            __m128i vb = _mm_loadu_si128( (const __m128i*)(b+i) );
+            __m128i vd = _mm_or_si128( _mm_subs_epu8(va,vb), _mm_subs_epu8(vb,va) );
+            _mm_storeu_si128( (__m128i*)(d+i), vd );
+        }
+#endif
+        for( ; i<n; i++ )
+            d[i] = ( a[i] > b[i] ) ? a[i]-b[i] : b[i]-a[i];
+    }
+
+    void compare( const vector<const Image*>& imgs, int w, int h, CompareLayout layout ) {
+        ImageCompareGUI g;
+        g.setup( imgs );
+        g.set_layout( layout );
+        g.create( w, h );
+        g.display();
+    }
+
+    ImageCompareGUI::ImageCompareGUI() {
+        layout   = CL_SIDE_BY_SIDE;
+        gw       = 1200;
+        gh       = 600;
+        mx       = 0;
+        my       = 0;
+        ia       = 0;
+        ib       = 1;
+        split_x  = 0;
+        frame    = 0;
+        bflicker = false;
+        bdirty   = true;
+        vmin     = 0.0f;
+        vmax     = 255.0f;
+        dt_scale = 0.0;
+        dt_a     = -1;
+        dt_b     = -1;
+        tile_a   = NULL;
+        tile_b   = NULL;
+    }
+
+    ImageCompareGUI::~ImageCompareGUI() {
+        if( tile_a ) cvReleaseImage( &tile_a );
+        if( tile_b ) cvReleaseImage( &tile_b );
+    }
+
+    void ImageCompareGUI::setup( const vector<const Image*>& images ) {
+        passert_statement( images.size() > 0, "no images to compare" );
+        imgs = images;
+        ia = 0;
+        ib = ( imgs.size() > 1 ) ? 1 : 0;
+
+        // single channel images share one stretch so that they stay comparable
+        bool first = true;
+        for( size_t i=0; i<imgs.size(); i++ ) {
+            assert_pointer( imgs[i] );
+            if( imgs[i]->ch() != 1 ) continue;
+            float lo, hi;
+            image_range( imgs[i], lo, hi );
+            if( first ) { vmin = lo; vmax = hi; first = false; }
+            vmin = std::min( vmin, lo );
+            vmax = std::max( vmax, hi );
+        }
+        bdirty = true;
+    }
+
+    void ImageCompareGUI::set_layout( CompareLayout l ) {
+        int pw = panel_width();
+        layout = l;
+        bdirty = true;
+        // the view was fitted to the old panel width
+        if( pw != panel_width() && !imgs.empty() )
+            fit_view();
+    }
+
+    int ImageCompareGUI::no_panels() const {
+        if( layout == CL_SIDE_BY_SIDE ) return std::max( 1, (int)imgs.size() );
+        return 1;
+    }
+
+    int ImageCompareGUI::panel_width() const {
+        return gw / no_panels();
+    }
+
+    void ImageCompareGUI::fit_view() {
+        view.fit( imgs[0]->w(), imgs[0]->h(), panel_width(), gh );
+        bdirty = true;
+    }
+
+    void ImageCompareGUI::create( int window_width, int window_height ) {
+        gw = (window_width) ? window_width : 1200;
+        if( window_height ) gh = window_height;
+        else                gh = panel_width() / double( imgs[0]->w() ) * imgs[0]->h();
+        split_x = gw/2;
+
+        wimg.set_name("compare window");
+        wimg.create_display( gw, gh );
+        wimg.create(0);
+        wimg.resize( gw, gh );
+        wimg.move( 0, 0 );
+        wimg.init_mouse();
+        fit_view();
+        render();
+        wimg.show();
+    }
+
+    void ImageCompareGUI::display( double time_out ) {
+        wimg.reset_mouse();
+
+        time_t st;
+        time_t now;
+        time( &st );
+
+        while( 1 ) {
+            if( !catch_keyboard() )
+                break;
+            catch_mouse();
+
+            if( bflicker && imgs.size() > 1 && layout == CL_FLICKER && ++frame % 15 == 0 ) {
+                std::swap( ia, ib );
+                bdirty = true;
+            }
+            if( bdirty )
+                render();
+
+            wimg.reset_display();
+            draw_overlays();
+            wimg.refresh();
+
+            if( time_out != 0.0 ) {
+                time( &now );
+                if( difftime( now, st ) > time_out )
+                    break;
+            }
+        }
+    }
+
+    // renders the columns [x,x+w) of the panel that starts at ox. the view
+    // is shared by all panels so only the panel-local offset changes.
+    void ImageCompareGUI::render_region( const Image* im, int ox, int x, int w ) {
+        if( w <= 0 ) return;
+        ViewTransform v = view;
+        v.x0 += ( x - ox ) * view.scale;
+        render_view( im, v, vmin, vmax, wimg.get_original_display(), x, 0, w, gh );
+    }
+
+    void ImageCompareGUI::render() {
+        IplImage* dst = wimg.get_original_display();
+        cvSet( dst, cvScalar(0,0,0) );
+
+        int pw = panel_width();
+        switch( layout ) {
+        case CL_SIDE_BY_SIDE:
+            for( int k=0; k<(int)imgs.size(); k++ )
+                render_region( imgs[k], k*pw, k*pw, pw );
+            break;
+        case CL_FLICKER:
+            render_region( imgs[ia], 0, 0, gw );
+            break;
+        case CL_SPLIT:
+            render_region( imgs[ia], 0, 0,       split_x    );
+            render_region( imgs[ib], 0, split_x, gw-split_x );
+            break;
+        case CL_DIFFERENCE:
+            render_difference();
+            break;
+        }
+        wimg.reset_display();
+        bdirty = false;
+    }
+
+    void ImageCompareGUI::clear_difference_tiles() {
+        diff_tiles.clear();
+        dt_scale = view.scale;
+        dt_a     = ia;
+        dt_b     = ib;
+    }
+
+    // returns the |a-b| tile at grid position (tx,ty). tiles are computed on
+    // first use only and stay valid while the scale and pair are unchanged,
+    // so panning only computes the newly exposed tiles.
+    const vector<uchar>& ImageCompareGUI::difference_tile( int tx, int ty ) {
+        const int T = DIFF_TILE_SIZE;
+        long long key = ( (long long)ty << 32 ) | (unsigned int)tx;
+
+        std::map<long long, vector<uchar> >::const_iterator it = diff_tiles.find( key );
+        if( it != diff_tiles.end() )
+            return it->second;
+
+        if( (int)diff_tiles.size() >= DIFF_TILE_CACHE_MAX )
+            diff_tiles.clear();
+
+        if( !tile_a ) tile_a = cvCreateImage( cvSize(T,T), IPL_DEPTH_8U, 3 );
+        if( !tile_b ) tile_b = cvCreateImage( cvSize(T,T), IPL_DEPTH_8U, 3 );
+
+        ViewTransform tv;
+        tv.scale = view.scale;
+        tv.x0    = double(tx) * T * view.scale;
+        tv.y0    = double(ty) * T * view.scale;
+        render_view( imgs[ia], tv, vmin, vmax, tile_a, 0, 0, T, T );
+        render_view( imgs[ib], tv, vmin, vmax, tile_b, 0, 0, T, T );
+
+        vector<uchar>& tile = diff_tiles[key];
+        tile.resize( 3*T*T );
+        for( int y=0; y<T; y++ ) {
+            absdiff_u8( (const uchar*)( tile_a->imageData + y*tile_a->widthStep ),
+                        (const uchar*)( tile_b->imageData + y*tile_b->widthStep ),
+                        &tile[3*T*y], 3*T );
+        }
+        return tile;
+    }
+
+    void ImageCompareGUI::render_difference() {
+        if( dt_scale != view.scale || dt_a != ia || dt_b != ib )
+            clear_difference_tiles();
+
+        const int T = DIFF_TILE_SIZE;
+        IplImage* dst = wimg.get_original_display();
+
+        // view is snapped, so its origin lies on the global display grid
+        long long gox = (long long)floor( view.x0/view.scale + 0.5 );
+        long long goy = (long long)floor( view.y0/view.scale + 0.5 );
+
+        int tx0 = floor_div( gox,        T );
+        int tx1 = floor_div( gox+gw-1,   T );
+        int ty0 = floor_div( goy,        T );
+        int ty1 = floor_div( goy+gh-1,   T );
+
+        for( int ty=ty0; ty<=ty1; ty++ ) {
+            for( int tx=tx0; tx<=tx1; tx++ ) {
+                const vector<uchar>& tile = difference_tile( tx, ty );
+                long long gx0 = std::max( (long long)tx*T,   gox    );
+                long long gx1 = std::min( (long long)tx*T+T, gox+gw );
+                long long gy0 = std::max( (long long)ty*T,   goy    );
+                long long gy1 = std::min( (long long)ty*T+T, goy+gh );
+                int nx = int( gx1-gx0 );
+                for( long long gy=gy0; gy<gy1; gy++ ) {
+                    uchar*       d = (uchar*)( dst->imageData + (gy-goy)*dst->widthStep ) + 3*(gx0-gox);
+                    const uchar* s = &tile[ 3*( (gy-(long long)ty*T)*T + (gx0-(long long)tx*T) ) ];
+                    memcpy( d, s, 3*nx );
+                }
+            }
+        }
+    }
+
+    void ImageCompareGUI::draw_overlays() {
+        int pw = panel_width();
+        int np = no_panels();
+
+        wimg.set_color( 255, 255, 10 );
+        switch( layout ) {
+        case CL_SIDE_BY_SIDE:
+            for( int k=0; k<np; k++ ) {
+                wimg.write( k*pw+10, 10, "["+num2str(k)+"]" );
+                if( k ) wimg.draw_line( k*pw, 0, k*pw, gh );
+            }
+            break;
+        case CL_FLICKER:
+            wimg.write( 10, 10, "["+num2str(ia)+"]" );
+            break;
+        case CL_SPLIT:
+            wimg.write( 10,         10, "["+num2str(ia)+"]" );
+            wimg.write( split_x+10, 10, "["+num2str(ib)+"]" );
+            wimg.draw_line( split_x, 0, split_x, gh );
+            break;
+        case CL_DIFFERENCE:
+            wimg.write( 10, 10, "|["+num2str(ia)+"]-["+num2str(ib)+"]|" );
+            break;
+        }
+
+        // cursor is linked across panels
+        wimg.set_color( 0, 255, 0 );
+        for( int k=0; k<np; k++ ) {
+            int cx = k*pw + mx;
+            wimg.draw_line( cx-10, my, cx-3, my );
+            wimg.draw_line( cx+3,  my, cx+10, my );
+            wimg.draw_line( cx, my-10, cx, my-3 );
+            wimg.draw_line( cx, my+3,  cx, my+10 );
+        }
+
+        double ix, iy;
+        view.display_to_image( mx, my, ix, iy );
+        wimg.set_color( 255, 255, 10 );
+        wimg.write( 10, gh-20, "("+num2str((int)floor(ix))+","+num2str((int)floor(iy))+") x"+num2str(float(1.0/view.scale),3) );
+    }
+
+    void ImageCompareGUI::reset_mouse() {
+        wimg.reset_mouse();
+    }
+
+    void ImageCompareGUI::catch_mouse() {
+        int pw = panel_width();
+        int x, y;
+        if( wimg.mouse_move_event( x, y ) ) {
+            mx = x % pw;
+            my = y;
+            wimg.reset_mouse();
+            return;
+        }
+
+        if( wimg.mouse_click( 2, x, y ) ) {
+            mx = x % pw;
+            my = y;
+            view.pan( mx - pw/2, my - gh/2 );
+            bdirty = true;
+        } else if( wimg.mouse_click( 1, x, y ) ) {
+            mx = x % pw;
+            my = y;
+            if( layout == CL_SPLIT ) {
+                split_x = x;
+                bdirty  = true;
+            }
+
+            double dx, dy;
+            view.display_to_image( mx, my, dx, dy );
+            int ix = (int)floor( dx );
+            int iy = (int)floor( dy );
+            printf( "clicked [%d %d]", ix, iy );
+            for( int k=0; k<(int)imgs.size(); k++ ) {
+                const Image* im = imgs[k];
+                if( ix < 0 || iy < 0 || ix >= im->w() || iy >= im->h() ) continue;
+                if( im->ch() == 1 ) {
+                    printf( " [%d: %f]", k, im->get(ix,iy) );
+                } else {
+                    uchar r, g, b;
+                    im->get( ix, iy, r, g, b );
+                    printf( " [%d: %d %d %d]", k, r, g, b );
+                }
+            }
+            printf( "\n" );
+        }
+        wimg.reset_mouse();
+    }
+
+    bool ImageCompareGUI::catch_keyboard() {
+        int c = wimg.wait( 20 );
+        int pw = panel_width();
+        int n  = (int)imgs.size();
+        if     ( c == 'q' ) return false;
+        else if( c == 's' ) set_layout( CL_SIDE_BY_SIDE );
+        else if( c == 'f' ) set_layout( CL_FLICKER      );
+        else if( c == 'l' ) set_layout( CL_SPLIT        );
+        else if( c == 'd' ) set_layout( CL_DIFFERENCE   );
+        else if( c == ' ' ) bflicker = !bflicker;
+        else if( c == 'p' ) { std::swap( ia, ib ); bdirty = true; }
+        else if( c == 'n' ) {
+            if( n > 1 ) {
+                ib = ( ib+1 ) % n;
+                if( ib == ia ) ib = ( ib+1 ) % n;
+            }
+            bdirty = true;
+        }
+        else if( c == '0' ) fit_view();
+        else if( c == '=' ) { view.zoom( mx, my, 0.8     ); bdirty = true; }
+        else if( c == '-' ) { view.zoom( mx, my, 1.0/0.8 ); bdirty = true; }
+        else if( c == 65361 ) { view.pan( -pw/10, 0 ); bdirty = true; } // left
+        else if( c == 65363 ) { view.pan(  pw/10, 0 ); bdirty = true; } // right
+        else if( c == 65362 ) { view.pan( 0, -gh/10 ); bdirty = true; } // up
+        else if( c == 65364 ) { view.pan( 0,  gh/10 ); bdirty = true; } // down
+        return true;
+    }
+
+}
+
+#endif
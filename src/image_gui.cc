@@ -17,8 +17,14 @@
 #include <kortex/string.h>
 
 #include "kortex/image_gui.h"
+#include "kortex/opencv_extensions.h"
+#include "kortex/view_transform.h"
+#include "kortex/feature_overlay.h"
+#include "kortex/flow_overlay.h"
 
 #include <ctime>
+#include <cmath>
+#include <algorithm>
 
 namespace kortex {
 
@@ -35,14 +41,29 @@ namespace kortex {
     ImageGUI::ImageGUI() {
         wzoom = NULL;
         imgp = NULL;
+        dimg = NULL;
+        cimg = NULL;
+        cmap = CMAP_GRAY;
+        overlay = NULL;
+        overlay_alpha = 0.5f;
+        overlay_cmap = CMAP_TURBO;
+        features = NULL;
+        flow = NULL;
+        regions = NULL;
+        hover_region = -1;
         bhover = true;
         benable_help = false;
         benable_shadow = true;
+        blow_memory = false;
         gx = 0;
         gy = 0;
         gw = 700;
         gh = 700;
-        zsz = 101;
+        zn = 31;
+        zmag = 10;
+        zx = zy = -1;
+        vmin = 0.0f;
+        vmax = 255.0f;
     }
 
     ImageGUI::~ImageGUI() {
@@ -51,6 +72,7 @@ namespace kortex {
             delete wzoom;
             wzoom = NULL;
         }
+        delete cimg;
     }
 
     void ImageGUI::toggle_zoom_window() {
@@ -61,22 +83,39 @@ namespace kortex {
             return;
         }
 
+        int zsz = zn*zmag;
         wzoom = new GUIWindow();
         wzoom->set_name("zoom");
+        wzoom->set_headless( wimg.is_headless() );
         wzoom->create_display( zsz, zsz );
         wzoom->create(0);
-        wzoom->resize( 3*zsz, 3*zsz );
+        wzoom->resize( zsz, zsz );
         wzoom->move( gw, 0 );
         wzoom->show();
+        zx = zy = -1;
     }
 
+    // magnifies the original image around the source pixel under the cursor.
+    // the magnified tile is kept in the zoom window and is only re-rendered
+    // when the cursor moves onto a different source pixel.
     void ImageGUI::update_zoom_window() {
         if( !wzoom ) return;
-        wzoom->set_display( &wimg, gx, gy, zsz );
-        int rw = zsz/2.5;
-        int px = zsz/2 - rw;
-        int py = zsz/2 - rw;
-        wzoom->draw_rectangle( px, py, 2*rw+1, 2*rw+1 );
+        if( gx == zx && gy == zy ) return;
+        zx = gx;
+        zy = gy;
+
+        int zsz = zn*zmag;
+        ViewTransform zview;
+        zview.scale = 1.0/zmag;
+        zview.x0    = zx - zn/2;
+        zview.y0    = zy - zn/2;
+        render_view( dimg, zview, vmin, vmax, wzoom->get_original_display(), 0, 0, zsz, zsz );
+        wzoom->reset_display();
+
+        int c = (zn/2)*zmag;
+        wzoom->set_color( 255, 0, 0 );
+        wzoom->draw_rectangle( c-1, c-1, zmag+1, zmag+1 );
+        wzoom->refresh();
     }
 
     void ImageGUI::create( int window_width ) {
@@ -85,28 +124,83 @@ namespace kortex {
         gh = gw / double( imgp->w() ) * imgp->h();
         wimg.set_name("image window");
 
-        if( imgp->ch() == 1 ) {
+        // images larger than the window are area-averaged down once so that
+        // overlays, resets and uploads scale with the window size
+        int factor = std::max( 1, (int)ceil( imgp->w() / double(gw) ) );
+        view = ViewTransform();
+        view.scale = factor;
+
+        image_range( imgp, vmin, vmax );
+        upload();
+        wimg.create(0);
+        wimg.resize(gw,gh);
+        wimg.move(0,0);
+        wimg.init_mouse();
+        wimg.show();
+    }
+
+    void ImageGUI::set_overlay( const Image* field, float alpha, ColormapType cm ) {
+        overlay       = field;
+        overlay_alpha = alpha;
+        overlay_cmap  = cm;
+    }
+
+    // colormaps / blends the image if needed and uploads it to the window.
+    // the low memory mode applies them to the downsampled display instead
+    // of making a full resolution color copy.
+    void ImageGUI::upload() {
+        dimg = imgp;
+        int  factor = (int)view.scale;
+        bool bcolor = overlay || ( cmap != CMAP_GRAY && imgp->ch() == 1 );
+        if( blow_memory && bcolor ) {
+            delete cimg;
+            cimg = NULL;
+            wimg.set_image( imgp, vmin, vmax, false, factor );
+            IplImage* od = wimg.get_original_display();
+            if( overlay ) blend_colormap_ipl( od, factor, overlay, Colormap( overlay_cmap ), 0.0f, 0.0f, overlay_alpha );
+            else          colormap_ipl( od, Colormap( cmap ) );
+            wimg.reset_display();
+            return;
+        }
+        if( bcolor ) {
+            if( !cimg ) cimg = new Image();
+            const Image* base = imgp;
+            if( imgp->ch() == 1 ) {
+                colormap_image( imgp, Colormap( overlay ? CMAP_GRAY : cmap ), vmin, vmax, cimg );
+                base = cimg;
+            }
+            if( overlay )
+                blend_colormap( base, overlay, Colormap( overlay_cmap ), 0.0f, 0.0f, overlay_alpha, cimg );
+            dimg = cimg;
+        }
+
+        if( blow_memory || factor > 1 ) {
+            wimg.set_image( dimg, vmin, vmax, blow_memory, factor );
+        } else if( dimg->ch() == 1 ) {
 
             Image tmp;
 
-            if( imgp->type() == IT_F_GRAY ) {
-                image_stretch( *imgp, 0.0f, 0.0f, tmp );
+            if( dimg->type() == IT_F_GRAY ) {
+                image_stretch( *dimg, 0.0f, 0.0f, tmp );
             } else {
                 Image gimg;
-                gimg.copy( imgp );
+                gimg.copy( dimg );
                 gimg.convert( IT_F_GRAY );
                 image_stretch( gimg, 0.0f, 0.0f, tmp );
             }
 
             wimg.set_image( &tmp );
         } else {
-            wimg.set_image( imgp );
+            wimg.set_image( dimg );
         }
-        wimg.create(0);
-        wimg.resize(gw,gh);
-        wimg.move(0,0);
-        wimg.init_mouse();
-        wimg.show();
+    }
+
+    // bytes held by the display buffers of the image and zoom windows and
+    // by the buffers the shared pool keeps for reuse
+    size_t ImageGUI::memory_usage() const {
+        size_t bytes = wimg.memory_usage() + GUIWindow::pool_memory_usage();
+        if( wzoom ) bytes += wzoom->memory_usage();
+        return bytes;
     }
 
     void ImageGUI::setup( const Image* img ) {
@@ -124,17 +218,45 @@ namespace kortex {
         else if( c == 'h' ) benable_help = !benable_help;
         else if( c == 'm' ) benable_shadow = !benable_shadow;
         else if( c == 'z' ) toggle_zoom_window();
+        else if( c == 'c' && ( overlay || imgp->ch() == 1 ) ) {
+            ColormapType& cm = overlay ? overlay_cmap : cmap;
+            cm = ColormapType( ( cm+1 ) % CMAP_COUNT );
+            if( overlay && cm == CMAP_GRAY ) cm = CMAP_JET;
+            printf( "colormap %s\n", colormap_name( cm ) );
+            upload();
+            zx = zy = -1;
+        }
         return true;
     }
 
+    void ImageGUI::display_to_image( int dx, int dy, int& ix, int& iy ) const {
+        double x, y;
+        view.display_to_image( dx+0.5, dy+0.5, x, y );
+        ix = std::min( imgp->w()-1, std::max( 0, (int)floor(x) ) );
+        iy = std::min( imgp->h()-1, std::max( 0, (int)floor(y) ) );
+    }
+
+    void ImageGUI::image_to_display( float ix, float iy, int& dx, int& dy ) const {
+        double x, y;
+        view.image_to_display( ix+0.5, iy+0.5, x, y );
+        dx = (int)floor( x );
+        dy = (int)floor( y );
+    }
+
     void ImageGUI::catch_mouse() {
-        if( bhover && wimg.mouse_move_event(gx,gy) ) {
+        int dx, dy;
+        if( bhover && wimg.mouse_move_event(dx,dy) ) {
+            display_to_image( dx, dy, gx, gy );
+            hover_region = region_at( dx, dy );
             wimg.reset_mouse();
         }
-        if( !wimg.mouse_click(1,gx,gy) ) {
+        if( !wimg.mouse_click(1,dx,dy) ) {
             return;
         }
+        display_to_image( dx, dy, gx, gy );
 
+        int rid = region_at( dx, dy );
+        if( rid != -1 ) printf("region %d ", rid);
         printf("clicked [%d %d] ", gx, gy);
 
         if( imgp->ch() == 1 ) {
@@ -161,6 +283,9 @@ namespace kortex {
             if( !catch_keyboard() )
                 break;
             catch_mouse();
+            draw_flow();
+            draw_features();
+            draw_regions();
             draw_mouse_shadow();
             update_zoom_window();
             display_help();
@@ -205,7 +330,6 @@ namespace kortex {
 
     void ImageGUI::refresh() {
         wimg.refresh();
-        if( wzoom ) wzoom->refresh();
     }
 
     void ImageGUI::display_help() {
@@ -216,31 +340,103 @@ namespace kortex {
         wimg.write( 10,  60, "q: quit" );
         wimg.write( 10,  80, "z: toggle zoom window" );
         wimg.write( 10, 100, "m: enable mouse shadow" );
+        wimg.write( 10, 120, "c: cycle colormap" );
     }
 
     void ImageGUI::display_messages() {
         uchar cr, cg, cb;
         get_color( COLOR_YELLOW, cr, cg, cb );
         wimg.set_color( cr, cg, cb );
-        wimg.write( 10, imgp->h()-20, "("+num2str(gx)+","+num2str(gy)+")" );
+        wimg.write( 10, wimg.h()-20, "("+num2str(gx)+","+num2str(gy)+")" );
+    }
+
+    void ImageGUI::draw_flow() {
+        if( !flow ) return;
+        flow->draw( &wimg, view );
+    }
+
+    void ImageGUI::draw_features() {
+        if( !features ) return;
+        features->draw( &wimg, view );
+    }
+
+    void ImageGUI::set_regions( const vector<Rect2f>* rects ) {
+        regions      = rects;
+        hover_region = -1;
+        if( regions ) region_tree.build( *regions );
+        else          region_tree.clear();
+    }
+
+    // innermost (smallest) region under a display pixel, -1 if none
+    int ImageGUI::region_at( int dx, int dy ) {
+        if( !regions ) return -1;
+        double x, y;
+        view.display_to_image( dx+0.5, dy+0.5, x, y );
+        region_tree.query_point( x, y, region_hits );
+        int   best = -1;
+        float area = 0.0f;
+        for( size_t k=0; k<region_hits.size(); k++ ) {
+            const Rect2f& r = (*regions)[ region_hits[k] ];
+            float a = ( r.ux-r.lx ) * ( r.uy-r.ly );
+            if( best == -1 || a < area ) {
+                best = region_hits[k];
+                area = a;
+            }
+        }
+        return best;
+    }
+
+    void ImageGUI::draw_regions() {
+        if( !regions ) return;
+        double x0, y0, x1, y1;
+        view.display_to_image( 0, 0, x0, y0 );
+        view.display_to_image( wimg.w(), wimg.h(), x1, y1 );
+        Rect2f vis;
+        vis.lx = x0; vis.ly = y0;
+        vis.ux = x1; vis.uy = y1;
+        region_tree.query_rect( vis, region_hits );
+
+        wimg.set_color( 0, 255, 255 );
+        wimg.set_thickness( 1 );
+        for( size_t k=0; k<region_hits.size(); k++ ) {
+            int id = region_hits[k];
+            if( id == hover_region ) continue;
+            const Rect2f& r = (*regions)[id];
+            view.image_to_display( r.lx, r.ly, x0, y0 );
+            view.image_to_display( r.ux, r.uy, x1, y1 );
+            wimg.draw_rectangle( (int)x0, (int)y0, (int)( x1-x0 ), (int)( y1-y0 ) );
+        }
+        if( hover_region != -1 ) {
+            const Rect2f& r = (*regions)[hover_region];
+            view.image_to_display( r.lx, r.ly, x0, y0 );
+            view.image_to_display( r.ux, r.uy, x1, y1 );
+            wimg.set_color( 255, 255, 0 );
+            wimg.set_thickness( 2 );
+            wimg.draw_rectangle( (int)x0, (int)y0, (int)( x1-x0 ), (int)( y1-y0 ) );
+            wimg.write( (int)x0, (int)y0-14, hover_region );
+            wimg.set_thickness( 1 );
+        }
     }
 
     void ImageGUI::draw_mouse_shadow() {
         if( !benable_shadow ) return;
 
+        int dx, dy;
+        image_to_display( gx, gy, dx, dy );
+
         wimg.set_color( 255, 255, 255 );
-        wimg.mark( gx, gy, 0 );
+        wimg.mark( dx, dy, 0 );
         wimg.set_color( 0, 255, 0 );
-        wimg.draw_line( gx, gy+4, gx, gy+17 );
-        wimg.draw_line( gx, gy-4, gx, gy-17 );
-        wimg.draw_line( gx+4, gy, gx+17, gy );
-        wimg.draw_line( gx-4, gy, gx-17, gy );
+        wimg.draw_line( dx, dy+4, dx, dy+17 );
+        wimg.draw_line( dx, dy-4, dx, dy-17 );
+        wimg.draw_line( dx+4, dy, dx+17, dy );
+        wimg.draw_line( dx-4, dy, dx-17, dy );
         wimg.set_color( 255, 0, 0 );
-        wimg.draw_line( gx+3, gy-3, gx+15, gy-15 );
-        wimg.draw_line( gx+3, gy+3, gx+15, gy+15 );
-        wimg.draw_line( gx-3, gy-3, gx-15, gy-15 );
-        wimg.draw_line( gx-3, gy+3, gx-15, gy+15 );
-        wimg.draw_circle( gx, gy, 15 );
+        wimg.draw_line( dx+3, dy-3, dx+15, dy-15 );
+        wimg.draw_line( dx+3, dy+3, dx+15, dy+15 );
+        wimg.draw_line( dx-3, dy-3, dx-15, dy-15 );
+        wimg.draw_line( dx-3, dy+3, dx-15, dy+15 );
+        wimg.draw_circle( dx, dy, 15 );
     }
 
 }
@@ -0,0 +1,171 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#ifdef WITH_OPENCV
+
+#include "kortex/input_log.h"
+#include <kortex/check.h>
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+namespace kortex {
+
+    namespace {
+        enum { RS_IDLE, RS_RUNNING, RS_FINAL, RS_DONE };
+
+        double now_in_seconds() {
+            return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+        }
+    }
+
+    void InputLog::save( const string& file ) const {
+        FILE* fp = fopen( file.c_str(), "w" );
+        passert_statement( fp, "could not open input log" );
+        fprintf( fp, "# frame time key x y event\n" );
+        for( size_t i=0; i<events.size(); i++ ) {
+            const InputEvent& e = events[i];
+            fprintf( fp, "%d %.6f %d %d %d %d\n", e.frame, e.time, e.key, e.x, e.y, e.event );
+        }
+        fclose( fp );
+    }
+
+    void InputLog::load( const string& file ) {
+        FILE* fp = fopen( file.c_str(), "r" );
+        passert_statement( fp, "could not open input log" );
+        events.clear();
+        char line[256];
+        while( fgets( line, sizeof(line), fp ) ) {
+            if( line[0] == '#' ) continue;
+            InputEvent e;
+            if( sscanf( line, "%d %lf %d %d %d %d", &e.frame, &e.time, &e.key, &e.x, &e.y, &e.event ) == 6 )
+                events.push_back( e );
+        }
+        fclose( fp );
+    }
+
+    double ReplayStats::percentile( double p ) const {
+        if( frame_ms.empty() ) return 0.0;
+        vector<double> t( frame_ms );
+        size_t k = std::min( t.size()-1, (size_t)( p/100.0 * t.size() ) );
+        std::nth_element( t.begin(), t.begin()+k, t.end() );
+        return t[k];
+    }
+
+    void ReplayStats::print( FILE* fp ) const {
+        double sum = 0.0;
+        for( size_t i=0; i<frame_ms.size(); i++ )
+            sum += frame_ms[i];
+        double mean = frame_ms.empty() ? 0.0 : sum/frame_ms.size();
+        fprintf( fp, "frames %d mean %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f ms hash %016llx\n",
+                 (int)frame_ms.size(), mean, percentile( 50 ), percentile( 90 ), percentile( 99 ),
+                 percentile( 100 ), frame_hash );
+    }
+
+    InputSession::InputSession() {
+        rec_log   = NULL;
+        rep_log   = NULL;
+        rep_stats = NULL;
+        rep_pos   = 0;
+        rep_state = RS_IDLE;
+        frame     = 0;
+        t0 = last = 0.0;
+        last_mouse.x = last_mouse.y = -1;
+        last_mouse.event = -1;
+    }
+
+    void InputSession::record( InputLog* log ) {
+        assert_pointer( log );
+        rec_log = log;
+        rep_log = NULL;
+        frame   = 0;
+        t0      = now_in_seconds();
+        last_mouse.x = last_mouse.y = -1;
+        last_mouse.event = -1;
+    }
+
+    void InputSession::replay( const InputLog* log, ReplayStats* stats ) {
+        assert_pointer( log && stats );
+        rec_log   = NULL;
+        rep_log   = log;
+        rep_stats = stats;
+        rep_pos   = 0;
+        rep_state = RS_RUNNING;
+        frame     = 0;
+        rep_stats->frame_ms.clear();
+        rep_stats->frame_hash = 0;
+    }
+
+    int InputSession::next_frame( int key, callback_info& mouse ) {
+        double t = now_in_seconds();
+
+        if( rec_log ) {
+            if( key != -1 || mouse.x != last_mouse.x || mouse.y != last_mouse.y || mouse.event != last_mouse.event ) {
+                InputEvent e;
+                e.frame = frame;
+                e.time  = t - t0;
+                e.key   = key;
+                e.x     = mouse.x;
+                e.y     = mouse.y;
+                e.event = mouse.event;
+                rec_log->add( e );
+                last_mouse = mouse;
+            }
+            frame++;
+            return key;
+        }
+
+        if( !rep_log ) return key;
+
+        if( frame > 0 && rep_state != RS_DONE )
+            rep_stats->frame_ms.push_back( (t-last)*1000.0 );
+        last = t;
+
+        if( rep_state == RS_FINAL ) rep_state = RS_DONE;
+        if( rep_state == RS_DONE  ) return 'q';
+
+        key = -1;
+        while( rep_pos < rep_log->size() && rep_log->at( rep_pos ).frame <= frame ) {
+            const InputEvent& e = rep_log->at( rep_pos++ );
+            mouse.x     = e.x;
+            mouse.y     = e.y;
+            mouse.event = e.event;
+            key         = e.key;
+        }
+        if( key == 'q' ) key = -1;
+        if( rep_pos == rep_log->size() )
+            rep_state = RS_FINAL;
+        frame++;
+        return key;
+    }
+
+    // fnv-1a over the visible pixels of the display
+    void InputSession::frame_shown( const IplImage* display ) {
+        if( !rep_log || rep_state != RS_FINAL || !display ) return;
+        unsigned long long h = 14695981039346656037ULL;
+        int rw = display->width * display->nChannels;
+        for( int y=0; y<display->height; y++ ) {
+            const uchar* row = (const uchar*)( display->imageData + y*display->widthStep );
+            for( int x=0; x<rw; x++ ) {
+                h ^= row[x];
+                h *= 1099511628211ULL;
+            }
+        }
+        rep_stats->frame_hash = h;
+    }
+
+}
+
+#endif
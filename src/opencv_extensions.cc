@@ -20,6 +20,15 @@
 #include <opencv2/highgui/highgui.hpp>
 
 #include "kortex/opencv_extensions.h"
+#include "kortex/view_transform.h"
+#include "kortex/buffer_pool.h"
+#include "kortex/colormap.h"
+
+#include <algorithm>
+
+#ifdef WITH_SSE
+#include <emmintrin.h>
+#endif
 
 using namespace std;
 
@@ -36,6 +45,20 @@ namespace kortex {
         draw_line(img, xy[2*no_points-2], xy[2*no_points-1], xy[0], xy[1], color, thickness );
     }
 
+    void draw_polylines( IplImage* img, const int* xy, const int* counts, int no_lines, Color* color, int thickness ) {
+        if( no_lines <= 0 ) return;
+        assert_pointer( img && xy && counts );
+        // CvPoint is a pair of ints: the lines point straight into xy
+        vector<CvPoint*> lines( no_lines );
+        const CvPoint* p = (const CvPoint*)xy;
+        for( int i=0; i<no_lines; i++ ) {
+            lines[i] = (CvPoint*)p;
+            p += counts[i];
+        }
+        CvScalar col = cvScalar( color->b, color->g, color->r );
+        cvPolyLine( img, &lines[0], counts, no_lines, 0, col, thickness, 8 );
+    }
+
 
     void draw_ray(IplImage* img, int x0, int y0, float length, float angle, Color* color, int thickness) {
         int px0 = x0+.5;
@@ -80,7 +103,7 @@ namespace kortex {
     void write_on_image_cv(Image* img, const std::vector<ImageTextInfo> &info ) {
         assert_pointer( img );
 
-        IplImage*tmp = cvCreateImage(cvSize(img->w(), img->h()), IPL_DEPTH_8U, 3);
+        IplImage*tmp = create_pooled_image( img->w(), img->h(), 3 );
         copy_image_to_color_ipl(img, tmp);
 
         for(size_t n=0; n<info.size(); n++ ) {
@@ -92,7 +115,7 @@ namespace kortex {
             write_on_image(tmp, iti.x, iti.y, iti.text, &col, &dp_font);
         }
         copy_ipl_to_image(tmp, img);
-        cvReleaseImage(&tmp);
+        release_pooled_image( &tmp );
     }
 
     void overlay_region(IplImage* img, int* occmap ) {
@@ -130,11 +153,168 @@ namespace kortex {
         }
     }
 
+    // single pass conversion of im into ipl. single channel sources are
+    // stretched from [vmin,vmax] and written either as gray (1 channel ipl)
+    // or replicated into bgr (3 channel ipl); color sources are swizzled.
+    void copy_image_to_ipl( const Image* im, float vmin, float vmax, IplImage* ipl ) {
+        assert_pointer( im && ipl );
+        im->passert_type( IT_U_GRAY | IT_F_GRAY | IT_U_PRGB );
+        passert_statement( ipl->height == im->h(), "dimension mismatch" );
+        passert_statement( ipl->width  == im->w(), "dimension mismatch" );
+        passert_statement( ipl->nChannels == 3 || ( ipl->nChannels == 1 && im->ch() == 1 ), "dimension mismatch" );
+
+        int w   = im->w();
+        int h   = im->h();
+        int inc = ipl->nChannels;
+
+        float vs = ( vmax > vmin ) ? 255.0f/(vmax-vmin) : 1.0f;
+        uchar lut[256];
+        for( int v=0; v<256; v++ )
+            lut[v] = (uchar)std::min( 255.0f, std::max( 0.0f, (v-vmin)*vs+0.5f ) );
+
+        ImageType itype = im->type();
+
+#pragma omp parallel for
+        for( int y=0; y<h; y++ ) {
+            uchar* drow = (uchar*)( ipl->imageData + y*ipl->widthStep );
+            switch( itype ) {
+            case IT_U_PRGB: {
+                const uchar* srow = im->get_row_u(y);
+                for( int x=0; x<w; x++ ) {
+                    drow[3*x  ] = srow[3*x+2];
+                    drow[3*x+1] = srow[3*x+1];
+                    drow[3*x+2] = srow[3*x  ];
+                }
+            } break;
+            case IT_U_GRAY: {
+                const uchar* srow = im->get_row_u(y);
+                if( inc == 1 ) {
+                    for( int x=0; x<w; x++ ) drow[x] = lut[ srow[x] ];
+                } else {
+                    for( int x=0; x<w; x++ ) drow[3*x] = drow[3*x+1] = drow[3*x+2] = lut[ srow[x] ];
+                }
+            } break;
+            default: {
+                const float* srow = im->get_row_f(y);
+                for( int x=0; x<w; x++ ) {
+                    uchar v = (uchar)std::min( 255.0f, std::max( 0.0f, (srow[x]-vmin)*vs+0.5f ) );
+                    if( inc == 1 ) drow[x] = v;
+                    else           drow[3*x] = drow[3*x+1] = drow[3*x+2] = v;
+                }
+            } break;
+            }
+        }
+    }
+
+    static void accumulate_row( const uchar* src, unsigned int* acc, int n ) {
+        int i = 0;
+#ifdef WITH_SSE
+        __m128i zero = _mm_setzero_si128();
+        for( ; i+16<=n; i+=16 ) {
+            __m128i v  = _mm_loadu_si128( (const __m128i*)(src+i) );
+            __m128i lo = _mm_unpacklo_epi8( v, zero );
+            __m128i hi = _mm_unpackhi_epi8( v, zero );
+            __m128i* a = (__m128i*)(acc+i);
+            _mm_storeu_si128( a,   _mm_add_epi32( _mm_loadu_si128(a  ), _mm_unpacklo_epi16(lo,zero) ) );
+            _mm_storeu_si128( a+1, _mm_add_epi32( _mm_loadu_si128(a+1), _mm_unpackhi_epi16(lo,zero) ) );
+            _mm_storeu_si128( a+2, _mm_add_epi32( _mm_loadu_si128(a+2), _mm_unpacklo_epi16(hi,zero) ) );
+            _mm_storeu_si128( a+3, _mm_add_epi32( _mm_loadu_si128(a+3), _mm_unpackhi_epi16(hi,zero) ) );
+        }
+#endif
+        for( ; i<n; i++ )
+            acc[i] += src[i];
+    }
+
+    static void accumulate_row( const float* src, float* acc, int n ) {
+        int i = 0;
+#ifdef WITH_SSE
+        for( ; i+4<=n; i+=4 )
+            _mm_storeu_ps( acc+i, _mm_add_ps( _mm_loadu_ps(acc+i), _mm_loadu_ps(src+i) ) );
+#endif
+        for( ; i<n; i++ )
+            acc[i] += src[i];
+    }
+
+    // area averaging downsample of im by an integer factor into a
+    // ceil(w/factor) x ceil(h/factor) ipl. boxes on the right and bottom
+    // borders are averaged over the pixels they actually cover. conversion
+    // rules are the same as copy_image_to_ipl.
+    void downsample_image_to_ipl( const Image* im, int factor, float vmin, float vmax, IplImage* ipl ) {
+        assert_pointer( im && ipl );
+        im->passert_type( IT_U_GRAY | IT_F_GRAY | IT_U_PRGB );
+        passert_statement( factor >= 1, "invalid downsampling factor" );
+
+        int f  = factor;
+        int w  = im->w();
+        int h  = im->h();
+        int nc = im->ch();
+        int ow = (w+f-1)/f;
+        int oh = (h+f-1)/f;
+        passert_statement( ipl->width == ow && ipl->height == oh, "dimension mismatch" );
+        passert_statement( ipl->nChannels == 3 || ( ipl->nChannels == 1 && nc == 1 ), "dimension mismatch" );
+
+        int   inc      = ipl->nChannels;
+        int   rw       = w*nc;
+        bool  is_float = ( im->precision() != TYPE_UCHAR );
+        float vs       = ( vmax > vmin ) ? 255.0f/(vmax-vmin) : 1.0f;
+        uchar lut[256];
+        for( int v=0; v<256; v++ )
+            lut[v] = (uchar)std::min( 255.0f, std::max( 0.0f, (v-vmin)*vs+0.5f ) );
+
+#pragma omp parallel
+        {
+            vector<unsigned int> uacc;
+            vector<float>        facc;
+            if( is_float ) facc.resize( rw );
+            else           uacc.resize( rw );
+
+#pragma omp for
+            for( int oy=0; oy<oh; oy++ ) {
+                int y0 = oy*f;
+                int y1 = std::min( h, y0+f );
+                if( is_float ) {
+                    std::fill( facc.begin(), facc.end(), 0.0f );
+                    for( int y=y0; y<y1; y++ )
+                        accumulate_row( im->get_row_f(y), &facc[0], rw );
+                } else {
+                    std::fill( uacc.begin(), uacc.end(), 0u );
+                    for( int y=y0; y<y1; y++ )
+                        accumulate_row( im->get_row_u(y), &uacc[0], rw );
+                }
+
+                uchar* drow = (uchar*)( ipl->imageData + oy*ipl->widthStep );
+                for( int ox=0; ox<ow; ox++ ) {
+                    int x0 = ox*f;
+                    int x1 = std::min( w, x0+f );
+                    float norm = 1.0f / ( (x1-x0)*(y1-y0) );
+                    float s[3] = { 0.0f, 0.0f, 0.0f };
+                    for( int x=x0; x<x1; x++ ) {
+                        for( int c=0; c<nc; c++ )
+                            s[c] += is_float ? facc[x*nc+c] : uacc[x*nc+c];
+                    }
+                    uchar* d = drow + inc*ox;
+                    if( nc == 3 ) {
+                        d[0] = (uchar)( s[2]*norm + 0.5f );
+                        d[1] = (uchar)( s[1]*norm + 0.5f );
+                        d[2] = (uchar)( s[0]*norm + 0.5f );
+                        continue;
+                    }
+                    float v = s[0]*norm;
+                    uchar u;
+                    if( is_float ) u = (uchar)std::min( 255.0f, std::max( 0.0f, (v-vmin)*vs+0.5f ) );
+                    else           u = lut[ (int)( v+0.5f ) ];
+                    for( int c=0; c<inc; c++ )
+                        d[c] = u;
+                }
+            }
+        }
+    }
+
     void copy_to_color_ipl(const IplImage* src, int x, int y, int w, IplImage* &dest) {
         assert_pointer( src && dest );
-        if( dest->height != w || dest->width != w ) {
-            cvReleaseImage(&dest);
-            dest = cvCreateImage( cvSize(w,w), IPL_DEPTH_8U, 3 );
+        if( dest->height != w || dest->width != w || dest->nChannels != 3 ) {
+            release_pooled_image( &dest );
+            dest = create_pooled_image( w, w, 3 );
         }
         cvSet(dest, cvScalar(0,0,0));
 
@@ -161,7 +341,7 @@ namespace kortex {
                 }
                 for(int c=0; c<3; c++)
                     (dest->imageData+dy*dest->widthStep)[dx*dest->nChannels+c] =
-                        (src->imageData+yy*src->widthStep)[xx*src->nChannels+c];
+                        (src->imageData+yy*src->widthStep)[xx*src->nChannels+std::min(c,src->nChannels-1)];
             }
         }
     }
@@ -175,8 +355,8 @@ namespace kortex {
         int nc = im->ch();
 
         if( ipl->height != h || ipl->width != w ) {
-            cvReleaseImage( &ipl );
-            ipl = cvCreateImage( cvSize(w,h), IPL_DEPTH_8U, 3 );
+            release_pooled_image( &ipl );
+            ipl = create_pooled_image( w, h, 3 );
         }
         assert( ipl->height == (int)h );
         assert( ipl->width  == (int)w );
@@ -235,10 +415,161 @@ namespace kortex {
         }
     }
 
+    // intensity range used to stretch single channel images for display
+    void image_range( const Image* im, float& vmin, float& vmax ) {
+        assert_pointer( im );
+        vmin = 0.0f;
+        vmax = 255.0f;
+        if( im->ch() != 1 ) return;
+
+        int w = im->w();
+        int h = im->h();
+        if( w == 0 || h == 0 ) return;
+        if( im->precision() == TYPE_UCHAR ) {
+            uchar umin = 255, umax = 0;
+            for( int y=0; y<h; y++ ) {
+                const uchar* row = im->get_row_u(y);
+                for( int x=0; x<w; x++ ) {
+                    umin = std::min( umin, row[x] );
+                    umax = std::max( umax, row[x] );
+                }
+            }
+            vmin = umin;
+            vmax = umax;
+        } else {
+            vmin = vmax = im->get_row_f(0)[0];
+            for( int y=0; y<h; y++ ) {
+                const float* row = im->get_row_f(y);
+                for( int x=0; x<w; x++ ) {
+                    vmin = std::min( vmin, row[x] );
+                    vmax = std::max( vmax, row[x] );
+                }
+            }
+        }
+    }
+
+    // renders the part of im seen through view into the pw x ph panel of
+    // dst starting at (px,py) using nearest sampling. single channel images
+    // are stretched from [vmin,vmax] to [0,255].
+    void render_view( const Image* im, const ViewTransform& view, float vmin, float vmax,
+                      IplImage* dst, int px, int py, int pw, int ph ) {
+        assert_pointer( im && dst );
+        im->passert_type( IT_U_GRAY | IT_F_GRAY | IT_U_PRGB );
+        passert_statement( dst->nChannels == 3, "invalid channel number" );
+        passert_statement( px >= 0 && px+pw <= dst->width,  "panel out of bounds" );
+        passert_statement( py >= 0 && py+ph <= dst->height, "panel out of bounds" );
+
+        int iw = im->w();
+        int ih = im->h();
+
+        vector<int> xmap( pw );
+        for( int x=0; x<pw; x++ ) {
+            int ix = (int)floor( view.x0 + (x+0.5)*view.scale );
+            xmap[x] = ( ix < 0 || ix >= iw ) ? -1 : ix;
+        }
+
+        float vs = ( vmax > vmin ) ? 255.0f/(vmax-vmin) : 1.0f;
+        uchar lut[256];
+        for( int v=0; v<256; v++ )
+            lut[v] = (uchar)std::min( 255.0f, std::max( 0.0f, (v-vmin)*vs+0.5f ) );
+
+        ImageType itype = im->type();
+
+#pragma omp parallel for
+        for( int y=0; y<ph; y++ ) {
+            uchar* drow = (uchar*)( dst->imageData + (py+y)*dst->widthStep ) + 3*px;
+            int iy = (int)floor( view.y0 + (y+0.5)*view.scale );
+            if( iy < 0 || iy >= ih ) {
+                memset( drow, 0, 3*pw );
+                continue;
+            }
+            for( int x=0; x<pw; x++ ) {
+                uchar* d = drow + 3*x;
+                int ix = xmap[x];
+                if( ix < 0 ) {
+                    d[0] = d[1] = d[2] = 0;
+                    continue;
+                }
+                switch( itype ) {
+                case IT_U_PRGB: {
+                    const uchar* s = im->get_row_u(iy) + 3*ix;
+                    d[0] = s[2];
+                    d[1] = s[1];
+                    d[2] = s[0];
+                } break;
+                case IT_U_GRAY:
+                    d[0] = d[1] = d[2] = lut[ im->get_row_u(iy)[ix] ];
+                    break;
+                default: {
+                    float v = ( im->get_row_f(iy)[ix] - vmin ) * vs;
+                    d[0] = d[1] = d[2] = (uchar)std::min( 255.0f, std::max( 0.0f, v+0.5f ) );
+                } break;
+                }
+            }
+        }
+    }
+
     void write_on_image( Image* im, const vector<ImageTextInfo>& tinfo ) {
         write_on_image_cv( im, tinfo );
     }
 
+    void colormap_ipl( IplImage* ipl, const Colormap& cmap ) {
+        assert_pointer( ipl );
+        passert_statement( ipl->nChannels == 3, "colormapping needs a color display" );
+        int w = ipl->width;
+        int h = ipl->height;
+#pragma omp parallel
+        {
+            vector<uchar> gray( w );
+#pragma omp for
+            for( int y=0; y<h; y++ ) {
+                uchar* row = (uchar*)( ipl->imageData + y*ipl->widthStep );
+                for( int x=0; x<w; x++ )
+                    gray[x] = row[3*x];
+                cmap.map_row( &gray[0], w, 0.0f, 255.0f, row, true );
+            }
+        }
+    }
+
+    void blend_colormap_ipl( IplImage* ipl, int factor, const Image* field, const Colormap& cmap,
+                             float vmin, float vmax, float alpha ) {
+        assert_pointer( ipl && field );
+        field->passert_type( IT_U_GRAY | IT_F_GRAY );
+        passert_statement( ipl->nChannels == 3, "blending needs a color display" );
+        passert_statement( factor >= 1, "invalid downsampling factor" );
+        int w  = ipl->width;
+        int h  = ipl->height;
+        int fw = field->w();
+        int fh = field->h();
+        passert_statement( ( fw+factor-1 )/factor == w && ( fh+factor-1 )/factor == h, "dimension mismatch" );
+        if( vmin >= vmax ) colormap_range( field, vmin, vmax );
+
+        bool is_float = ( field->precision() != TYPE_UCHAR );
+#pragma omp parallel
+        {
+            vector<float> v( w );
+            vector<uchar> over( 3*w ), mix( 3*w );
+#pragma omp for
+            for( int y=0; y<h; y++ ) {
+                int fy = std::min( fh-1, y*factor + factor/2 );
+                for( int x=0; x<w; x++ ) {
+                    int fx = std::min( fw-1, x*factor + factor/2 );
+                    v[x] = is_float ? field->get_row_f(fy)[fx] : (float)field->get_row_u(fy)[fx];
+                }
+                uchar* row = (uchar*)( ipl->imageData + y*ipl->widthStep );
+                cmap.map_row( &v[0], w, vmin, vmax, &over[0], true );
+                blend_row( row, &over[0], 3*w, alpha, &mix[0] );
+                // holes of the field show the display
+                for( int x=0; x<w; x++ ) {
+                    if( v[x] != v[x] ) continue;
+                    row[3*x+0] = mix[3*x+0];
+                    row[3*x+1] = mix[3*x+1];
+                    row[3*x+2] = mix[3*x+2];
+                }
+            }
+        }
+    }
+
 
 }
 
@@ -12,28 +12,142 @@
 //
 // ---------------------------------------------------------------------------
 #include "kortex/plot.h"
+#include "kortex/plot_stream.h"
+#include "kortex/plot_file.h"
 #include <kortex/minmax.h>
 #include <kortex/string.h>
 #include <kortex/math.h>
 
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <cstring>
+
+#ifdef WITH_SSE
+#include <emmintrin.h>
+#endif
+
 namespace kortex {
 
+    namespace {
+        const Color series_palette[] = {
+            Color( 255, 255,   0 ), Color(  10, 255,   0 ), Color(   0, 200, 255 ), Color( 255,   0, 255 ),
+            Color( 255, 128,   0 ), Color( 200, 200, 200 ), Color( 255,  60,  60 ), Color(  80, 120, 255 )
+        };
+        const int series_palette_size = sizeof(series_palette)/sizeof(series_palette[0]);
+
+        // points per structure-of-arrays batch of the draw and search loops
+        const int BATCH_SIZE = 512;
+    }
+
+    PlotSeries::PlotSeries() {
+        xs = ys = NULL;
+        x_type = y_type = PST_FLOAT;
+        n = 0;
+        x_stride = y_stride = 1;
+        x_origin = y_origin = 0.0;
+        stream = NULL;
+        file = NULL;
+        color = series_palette[0];
+        ptype = PT_DOT | PT_LINE;
+        x_min = y_min = 0.0f;
+        x_max = y_max = 1.0f;
+        bmonotone = true;
+        m4_w = m4_h = 0;
+        m4_valid = false;
+        dens_w = dens_h = 0;
+        dens_valid = false;
+        kd_valid = false;
+    }
+
+    // first sample with x >= rx. only valid for monotone x.
+    int PlotSeries::lower_sample( float rx ) const {
+        int lo = 0, hi = size();
+        while( lo < hi ) {
+            int mid = lo + (hi-lo)/2;
+            if( x(mid) < rx ) lo = mid+1;
+            else              hi = mid;
+        }
+        return lo;
+    }
+
+    // first sample with x > rx. only valid for monotone x.
+    int PlotSeries::upper_sample( float rx ) const {
+        int lo = 0, hi = size();
+        while( lo < hi ) {
+            int mid = lo + (hi-lo)/2;
+            if( x(mid) <= rx ) lo = mid+1;
+            else               hi = mid;
+        }
+        return lo;
+    }
+
+    // single pass over the view for the bounds and monotonicity. the search
+    // index is dropped and rebuilt by the next find_closest.
+    void PlotSeries::update_bounds() {
+        m4_valid   = false;
+        dens_valid = false;
+        kd_valid   = false;
+        vector<int>().swap( kd_index );
+        if( file ) {
+            x_min = float( -x_origin );
+            x_max = float( std::max( 1.0, double( file->size() ) - 1.0 ) - x_origin );
+            y_min = float( file->y_min() - y_origin );
+            y_max = float( file->y_max() - y_origin );
+            bmonotone = true;
+            return;
+        }
+        int ns = size();
+        if( ns == 0 ) return;
+        if( stream ) {
+            x_min = x(0);
+            x_max = x(ns-1);
+            y_min = stream->y_min();
+            y_max = stream->y_max();
+            bmonotone = true;
+            return;
+        }
+        x_min = x_max = x(0);
+        y_min = y_max = y(0);
+        bmonotone = true;
+        for( int i=1; i<ns; i++ ) {
+            float xv = x(i);
+            float yv = y(i);
+            if( xv < x(i-1) ) bmonotone = false;
+            x_min = std::min( x_min, xv );
+            x_max = std::max( x_max, xv );
+            y_min = std::min( y_min, yv );
+            y_max = std::max( y_max, yv );
+        }
+    }
+
     Plot::Plot() {
         gw = gh = 0;
         bgrid = true;
+        grid_w = grid_h = 0;
+        grid_valid = false;
+        bview = false;
+        x_origin = y_origin = 0.0;
+        borigin = false;
+        update_transform();
+        stream = NULL;
+        bscroll = true;
     }
     Plot::~Plot() {
     }
 
     void Plot::set_params( PlotParams& gparams ) {
         params = gparams;
+        update_transform();
     }
 
     void Plot::create( int w, int h ) {
         gw = w;
         gh = h;
+        update_transform();
         wmain.set_name("plot");
         wmain.create_display(w,h);
+        grid_valid = false;
         wmain.create(0);
         wmain.resize(w,h);
         wmain.move(0,0);
@@ -41,14 +155,59 @@ namespace kortex {
         wmain.show();
     }
 
+    // the view starts at the first sample. it is set up once so that
+    // repeated renders of a plot draw the same view.
+    void Plot::init_view() {
+        if( stream ) {
+            update_stream();
+            return;
+        }
+        if( bview ) return;
+        if( !series.empty() && series[0].file ) {
+            const PlotSeries& s = series[0];
+            if( s.file->size() ) shift_y( float( s.file->sample(0) - s.y_origin ) );
+            bview = true;
+        } else if( has_samples() ) {
+            shift_x( series[0].x(0) );
+            shift_y( series[0].y(0) );
+            bview = true;
+        }
+    }
+
+    void Plot::create_headless( int w, int h ) {
+        passert_statement( w > 0 && h > 0, "invalid plot size" );
+        gw = w;
+        gh = h;
+        update_transform();
+        wmain.set_headless( true );
+        wmain.create_display( w, h );
+        grid_valid = false;
+    }
+
+    void Plot::render( int w, int h, Image* out ) {
+        assert_pointer( out );
+        create_headless( w, h );
+        init_view();
+        redraw();
+        wmain.get_screen( out );
+    }
+
+    void Plot::render( int w, int h, const string& file ) {
+        create_headless( w, h );
+        init_view();
+        redraw();
+        wmain.save_screen( file );
+    }
+
     void Plot::display() {
-        shift_x( xvals[0] );
-        shift_y( yvals[0] );
+        init_view();
         wmain.reset_mouse();
         redraw();
         while( 1 ) {
             if( !catch_keyboard() )
                 break;
+            if( stream )
+                update_stream();
             redraw();
             catch_mouse();
             refresh();
@@ -56,12 +215,24 @@ namespace kortex {
     }
 
     void Plot::redraw() {
+        update_grid();
         reset_display();
-        draw_grid();
         draw_data();
         refresh();
     }
 
+    void Plot::update_grid() {
+        if( grid_valid && is_view_equal( grid_params, grid_w, grid_h ) )
+            return;
+        wmain.clear_display();
+        draw_grid();
+        wmain.save_display();
+        grid_params = params;
+        grid_w      = gw;
+        grid_h      = gh;
+        grid_valid  = true;
+    }
+
     void Plot::refresh() {
         wmain.refresh();
     }
@@ -87,35 +258,41 @@ namespace kortex {
         float rx, ry;
         gxy_to_rxy( mx+5, my+5, rx, ry );
 
+        if( !has_samples() ) return;
+
         float gx, gy;
-        int pid = find_closest( rx, ry );
-        rxy_to_gxy( xvals[pid], yvals[pid], gx, gy );
+        int sid;
+        int pid = find_closest( rx, ry, sid );
+        float cx = series[sid].x( pid );
+        float cy = series[sid].y( pid );
+        rxy_to_gxy( cx, cy, gx, gy );
         wmain.mark( gx, gy, 4 );
 
-        float cx = xvals[pid];
-        float cy = yvals[pid];
-        wmain.write( 20, gh-20, "Mouse ("+num2str(rx,3)+","+num2str(ry,3)+") -> [ Closest Point "+num2str(pid)+ " ]" );
+        string sname = series.size() > 1 ? " of Series "+num2str(sid) : "";
+        wmain.write( 20, gh-20, "Mouse ("+num2str(rx+x_origin,3)+","+num2str(ry+y_origin,3)+") -> [ Closest Point "+num2str(pid)+sname+ " ]" );
 
         float gx0, gy0;
-        rxy_to_gxy( cx, 0, gx0, gy0 );
+        rxy_to_gxy( cx, -y_origin, gx0, gy0 );
         wmain.draw_line( gx, gy, gx0, gy0 );
-        wmain.write( gx0+3, gy0-12, num2str(cx,5) );
+        wmain.write( gx0+3, gy0-12, num2str(cx+x_origin,5) );
 
-        rxy_to_gxy( 0, cy, gx0, gy0 );
+        rxy_to_gxy( -x_origin, cy, gx0, gy0 );
         wmain.draw_line( gx, gy, gx0, gy0 );
-        wmain.write( gx0+3, gy0-12, num2str(cy,5) );
+        wmain.write( gx0+3, gy0-12, num2str(cy+y_origin,5) );
 
     }
 
     bool Plot::catch_keyboard() {
         int c = wmain.wait(40);
         if     ( c == 'q' ) return false;
+        else if( c == 's' ) bscroll = !bscroll;
         else if( c == 'g' ) {
             bgrid = !bgrid;
             redraw();
         } else if( c == '0' ) {
             params.zoom_factor = 1.0;
-            center_coordinate( 0, 0 );
+            update_transform();
+            center_coordinate( -x_origin, -y_origin );
             redraw();
         } else if( c == 65361 ) { // right
             shift_x( -x_range()/10 );
@@ -141,23 +318,34 @@ namespace kortex {
 
     void Plot::shift_x( float xs ) {
         params.x_shift += xs;
+        update_transform();
+        rebase_origin();
     }
 
     void Plot::shift_y( float ys ) {
         params.y_shift += ys;
+        update_transform();
+        rebase_origin();
     }
 
     void Plot::zoom( float zf ) {
         float zx, zy, rx, ry;
 
         gxy_to_rxy(mx, my, rx, ry);
-        int pid = find_closest(rx,ry);
-        zx = xvals[pid];
-        zy = yvals[pid];
+        if( has_samples() ) {
+            int sid;
+            int pid = find_closest(rx,ry,sid);
+            zx = series[sid].x(pid);
+            zy = series[sid].y(pid);
+        } else {
+            zx = rx;
+            zy = ry;
+        }
         params.zoom_factor *= zf;
         if( params.zoom_factor <= 1.0/128.0 ) {
             params.zoom_factor = 1.0/128.0;
         }
+        update_transform();
         center_coordinate( zx, zy );
     }
 
@@ -170,26 +358,27 @@ namespace kortex {
         gy = gh - params.y_margin - cy;
     }
 
+    void Plot::update_transform() {
+        tsx = (params.x_max-params.x_min) / (gw-2*params.x_margin) * params.zoom_factor;
+        tsy = (params.y_max-params.y_min) / (gh-2*params.y_margin) * params.zoom_factor;
+        tix = 1.0f / tsx;
+        tiy = 1.0f / tsy;
+    }
+
     void Plot::gxy_to_rxy( float gx, float gy, float& rx, float& ry ) const {
         float cx, cy;
         gxy_to_cxy( gx, gy, cx, cy );
-        float sx = (params.x_max-params.x_min) / (gw-2*params.x_margin) * params.zoom_factor;
-        float sy = (params.y_max-params.y_min) / (gh-2*params.y_margin) * params.zoom_factor;
-        rx = sx * cx + params.x_shift;
-        ry = sy * cy + params.y_shift;
+        rx = tsx * cx + params.x_shift;
+        ry = tsy * cy + params.y_shift;
     }
 
     void Plot::rxy_to_cxy( float rx, float ry, float& cx, float& cy ) const {
-        float sx = (params.x_max-params.x_min) / (gw-2*params.x_margin) * params.zoom_factor;
-        float sy = (params.y_max-params.y_min) / (gh-2*params.y_margin) * params.zoom_factor;
-        cx = (rx - params.x_shift)/sx;
-        cy = (ry - params.y_shift)/sy;
+        cx = (rx - params.x_shift)*tix;
+        cy = (ry - params.y_shift)*tiy;
     }
     void Plot::cxy_to_rxy( float cx, float cy, float& rx, float& ry ) const {
-        float sx = (params.x_max-params.x_min) / (gw-2*params.x_margin) * params.zoom_factor;
-        float sy = (params.y_max-params.y_min) / (gh-2*params.y_margin) * params.zoom_factor;
-        rx = cx * sx + params.x_shift;
-        ry = cy * sy + params.y_shift;
+        rx = cx * tsx + params.x_shift;
+        ry = cy * tsy + params.y_shift;
     }
 
     bool Plot::is_visible( float gx, float gy ) const {
@@ -208,10 +397,83 @@ namespace kortex {
     }
 
 
+    // the batch version below evaluates the same expressions lane-wise so
+    // that both give identical coordinates
     void Plot::rxy_to_gxy( float rx, float ry, float& gx, float& gy ) const {
-        float sx = (params.x_max-params.x_min) / (gw-2*params.x_margin) * params.zoom_factor;
-        float sy = (params.y_max-params.y_min) / (gh-2*params.y_margin) * params.zoom_factor;
-        cxy_to_gxy( (rx - params.x_shift)/sx, (ry-params.y_shift)/sy, gx, gy );
+        gx = (rx - params.x_shift)*tix + params.x_margin;
+        gy = (gh - params.y_margin) - (ry - params.y_shift)*tiy;
+    }
+
+    void Plot::rxy_to_gxy( const float* rx, const float* ry, int n, float* gx, float* gy ) const {
+        int i = 0;
+#ifdef WITH_SSE
+        __m128 xs = _mm_set1_ps( params.x_shift );
+        __m128 ys = _mm_set1_ps( params.y_shift );
+        __m128 ix = _mm_set1_ps( tix );
+        __m128 iy = _mm_set1_ps( tiy );
+        __m128 xm = _mm_set1_ps( params.x_margin );
+        __m128 ym = _mm_set1_ps( gh - params.y_margin );
+        for( ; i+4<=n; i+=4 ) {
+            __m128 x = _mm_loadu_ps( rx+i );
+            __m128 y = _mm_loadu_ps( ry+i );
+            _mm_storeu_ps( gx+i, _mm_add_ps( _mm_mul_ps( _mm_sub_ps( x, xs ), ix ), xm ) );
+            _mm_storeu_ps( gy+i, _mm_sub_ps( ym, _mm_mul_ps( _mm_sub_ps( y, ys ), iy ) ) );
+        }
+#endif
+        for( ; i<n; i++ )
+            rxy_to_gxy( rx[i], ry[i], gx[i], gy[i] );
+    }
+
+    // outcodes of the plot area as tested by is_visible
+    void Plot::clip_codes( const float* gx, const float* gy, int n, uchar* codes ) const {
+        float x0 = params.x_margin, x1 = gw-params.x_margin;
+        float y0 = params.y_margin, y1 = gh-params.y_margin;
+        int i = 0;
+#ifdef WITH_SSE
+        __m128  vx0 = _mm_set1_ps( x0 ), vx1 = _mm_set1_ps( x1 );
+        __m128  vy0 = _mm_set1_ps( y0 ), vy1 = _mm_set1_ps( y1 );
+        __m128i b0  = _mm_set1_epi32( 1 ), b1 = _mm_set1_epi32( 2 );
+        __m128i b2  = _mm_set1_epi32( 4 ), b3 = _mm_set1_epi32( 8 );
+        for( ; i+4<=n; i+=4 ) {
+            __m128 x = _mm_loadu_ps( gx+i );
+            __m128 y = _mm_loadu_ps( gy+i );
+            __m128i c = _mm_and_si128( _mm_castps_si128( _mm_cmplt_ps( x, vx0 ) ), b0 );
+            c = _mm_or_si128( c, _mm_and_si128( _mm_castps_si128( _mm_cmpge_ps( x, vx1 ) ), b1 ) );
+            c = _mm_or_si128( c, _mm_and_si128( _mm_castps_si128( _mm_cmplt_ps( y, vy0 ) ), b2 ) );
+            c = _mm_or_si128( c, _mm_and_si128( _mm_castps_si128( _mm_cmpge_ps( y, vy1 ) ), b3 ) );
+            c = _mm_packs_epi32 ( c, c );
+            c = _mm_packus_epi16( c, c );
+            int packed = _mm_cvtsi128_si32( c );
+            memcpy( codes+i, &packed, 4 );
+        }
+#endif
+        for( ; i<n; i++ ) {
+            uchar c = 0;
+            if( gx[i] <  x0 ) c |= 1;
+            if( gx[i] >= x1 ) c |= 2;
+            if( gy[i] <  y0 ) c |= 4;
+            if( gy[i] >= y1 ) c |= 8;
+            codes[i] = c;
+        }
+    }
+
+    // copies samples [i0,i0+n) of a series into data coordinate arrays
+    int Plot::gather_samples( const PlotSeries& s, int i0, int n, float* rx, float* ry ) const {
+        n = std::min( n, s.size()-i0 );
+        for( int k=0; k<n; k++ ) {
+            rx[k] = s.x( i0+k );
+            ry[k] = s.y( i0+k );
+        }
+        return n;
+    }
+
+    // polyline through the points. segments with both ends beyond the same
+    // side of the plot area are skipped.
+    void Plot::draw_segments( const float* gx, const float* gy, const uchar* codes, int n ) {
+        for( int i=0; i<n-1; i++ ) {
+            if( codes[i] & codes[i+1] ) continue;
+            wmain.draw_line( gx[i], gy[i], gx[i+1], gy[i+1] );
+        }
     }
 
     void Plot::find_shift_to_center( float tx, float ty, float& xs, float& ys ) const {
@@ -226,15 +488,16 @@ namespace kortex {
         find_shift_to_center( tx, ty, xs, ys );
         params.x_shift -= xs;
         params.y_shift -= ys;
+        update_transform();
+        rebase_origin();
     }
 
     void Plot::set( const vector<float>& xs, const vector<float>& ys ) {
+        passert_statement( xs.size() == ys.size(), "dimension mismatch" );
         yvals = ys;
         xvals = xs;
-        kortex::min( xvals, params.x_min );
-        kortex::max( xvals, params.x_max );
-        kortex::min( yvals, params.y_min );
-        kortex::max( yvals, params.y_max );
+        clear_series();
+        add_series( xvals.data(), yvals.data(), (int)yvals.size() );
         // printf( "xr %f %f\n", params.x_min, params.x_max );
         // printf( "yr %f %f\n", params.y_min, params.y_max );
     }
@@ -244,14 +507,188 @@ namespace kortex {
         xvals.resize( yvals.size() );
         for( int i=0; i<(int)yvals.size(); i++ )
             xvals[i] = i;
-        kortex::min( xvals, params.x_min );
-        kortex::max( xvals, params.x_max );
-        kortex::min( yvals, params.y_min );
-        kortex::max( yvals, params.y_max );
+        clear_series();
+        add_series( xvals.data(), yvals.data(), (int)yvals.size() );
         // printf( "xr %f %f\n", params.x_min, params.x_max );
         // printf( "yr %f %f\n", params.y_min, params.y_max );
     }
 
+    void Plot::set_type( int pt ) {
+        params.ptype = pt;
+        for( int k=0; k<(int)series.size(); k++ )
+            series[k].ptype = pt;
+    }
+
+    int Plot::add_series( const PlotSeries& s ) {
+        passert_statement( s.n == 0 || s.ys || s.stream || s.file, "null series" );
+        if( series.empty() && !borigin )
+            pick_origin( s );
+        int sid = (int)series.size();
+        series.push_back( s );
+        PlotSeries& ns = series.back();
+        apply_origin( ns );
+        ns.color = series_palette[ sid % series_palette_size ];
+        ns.ptype = params.ptype;
+        ns.update_bounds();
+        update_bounds();
+        return sid;
+    }
+
+    // only types that float can not hold exactly need an origin. integer
+    // buffers keep an integral origin.
+    void Plot::pick_origin( const PlotSeries& s ) {
+        x_origin = y_origin = 0.0;
+        if( s.stream || s.file || s.n == 0 ) return;
+        if( s.xs && s.x_type != PST_FLOAT && s.x_type != PST_INT16 )
+            x_origin = plot_sample( s.xs, s.x_type, 0, 0.0 );
+        if( s.y_type != PST_FLOAT && s.y_type != PST_INT16 )
+            y_origin = plot_sample( s.ys, s.y_type, 0, 0.0 );
+    }
+
+    void Plot::set_origin( double x0, double y0 ) {
+        x_origin = x0;
+        y_origin = y0;
+        borigin  = true;
+        update_origins();
+    }
+
+    // integer buffers and the sample index of files keep an integral origin
+    // so that plot_sample subtracts it exactly
+    void Plot::apply_origin( PlotSeries& s ) const {
+        bool xint = s.file || s.x_type == PST_INT32 || s.x_type == PST_INT64;
+        bool yint = s.y_type == PST_INT32 || s.y_type == PST_INT64;
+        s.x_origin = xint ? floor( x_origin+0.5 ) : x_origin;
+        s.y_origin = yint ? floor( y_origin+0.5 ) : y_origin;
+    }
+
+    void Plot::update_origins() {
+        for( int k=0; k<(int)series.size(); k++ ) {
+            PlotSeries& s = series[k];
+            if( s.stream ) continue;
+            apply_origin( s );
+            s.update_bounds();
+        }
+        update_bounds();
+    }
+
+    // view coordinates are floats relative to the origin. once the view has
+    // moved far from the origin compared to its width, the origin is moved
+    // to the view centre so that the view keeps sub-pixel resolution.
+    void Plot::rebase_origin() {
+        if( stream || series.empty() ) return;
+        if( gw <= 2*params.x_margin || gh <= 2*params.y_margin ) return;
+
+        bool xint = false, yint = false;
+        for( int k=0; k<(int)series.size(); k++ ) {
+            const PlotSeries& s = series[k];
+            xint |= s.file || s.x_type == PST_INT32 || s.x_type == PST_INT64;
+            yint |= s.y_type == PST_INT32 || s.y_type == PST_INT64;
+        }
+
+        float cx, cy;
+        gxy_to_rxy( gw/2.0f, gh/2.0f, cx, cy );
+        double xr = 1024.0 * tsx * (gw-2*params.x_margin);
+        double yr = 1024.0 * tsy * (gh-2*params.y_margin);
+
+        double x0 = x_origin + cx;
+        double y0 = y_origin + cy;
+        if( xint ) x0 = floor( x0+0.5 );
+        if( yint ) y0 = floor( y0+0.5 );
+        // moving is only worth it if the centre gets much closer to the origin
+        bool bx = fabs( cx ) > xr && fabs( x0-x_origin-cx ) < 0.5*fabs( cx );
+        bool by = fabs( cy ) > yr && fabs( y0-y_origin-cy ) < 0.5*fabs( cy );
+        if( !bx && !by ) return;
+        if( !bx ) x0 = x_origin;
+        if( !by ) y0 = y_origin;
+
+        params.x_shift = float( x_origin + params.x_shift - x0 );
+        params.y_shift = float( y_origin + params.y_shift - y0 );
+        x_origin = x0;
+        y_origin = y0;
+        update_origins();
+    }
+
+    void Plot::set_series_color( int sid, const Color& col ) {
+        passert_statement( sid >= 0 && sid < (int)series.size(), "invalid series" );
+        series[sid].color = col;
+    }
+
+    void Plot::set_series_type( int sid, int pt ) {
+        passert_statement( sid >= 0 && sid < (int)series.size(), "invalid series" );
+        series[sid].ptype = pt;
+    }
+
+    void Plot::clear_series() {
+        series.clear();
+        stream = NULL;
+        bview  = false;
+    }
+
+    // axes are scaled to the union of all series
+    void Plot::update_bounds() {
+        bool first = true;
+        for( int k=0; k<(int)series.size(); k++ ) {
+            const PlotSeries& s = series[k];
+            if( s.size() == 0 && !s.file ) continue;
+            if( first ) {
+                params.x_min = s.x_min;  params.x_max = s.x_max;
+                params.y_min = s.y_min;  params.y_max = s.y_max;
+                first = false;
+                continue;
+            }
+            params.x_min = std::min( params.x_min, s.x_min );
+            params.x_max = std::max( params.x_max, s.x_max );
+            params.y_min = std::min( params.y_min, s.y_min );
+            params.y_max = std::max( params.y_max, s.y_max );
+        }
+        update_transform();
+    }
+
+    // file series are drawn from their pyramid and are not searched by
+    // find_closest
+    bool Plot::has_samples() const {
+        for( int k=0; k<(int)series.size(); k++ )
+            if( series[k].size() ) return true;
+        return false;
+    }
+
+    int Plot::add_series( const PlotFile* pf, const string& legend ) {
+        assert_pointer( pf );
+        PlotSeries s;
+        s.file   = pf;
+        s.legend = legend;
+        return add_series( s );
+    }
+
+    void Plot::set_stream( PlotStream* ps ) {
+        clear_series();
+        PlotSeries s;
+        s.stream = ps;
+        add_series( s );
+        stream  = ps;
+        bscroll = true;
+    }
+
+    // publishes the newest stream window and scrolls the x-axis with it. the
+    // y bounds come from the monotonic deques of the stream.
+    void Plot::update_stream() {
+        stream->update();
+        for( int k=0; k<(int)series.size(); k++ )
+            if( series[k].stream ) series[k].update_bounds();
+        update_bounds();
+        if( series.empty() || series[0].size() == 0 ) return;
+
+        if( params.x_max <= params.x_min ) params.x_max = params.x_min + 1.0f;
+        if( params.y_max <= params.y_min ) params.y_max = params.y_min + 1.0f;
+
+        if( bscroll ) {
+            params.zoom_factor = 1.0;
+            params.x_shift     = params.x_min;
+            params.y_shift     = params.y_min;
+        }
+        update_transform();
+    }
+
     void Plot::catch_mouse() {
         if( wmain.mouse_move_event(mx,my) ) {
             draw_mouse_shadow();
@@ -264,8 +701,11 @@ namespace kortex {
             my-=5;
             gxy_to_cxy( mx, my, cx, cy );
             gxy_to_rxy( mx, my, rx, ry );
-            int pid = find_closest( rx, ry );
-            center_coordinate( xvals[pid], yvals[pid] );
+            if( has_samples() ) {
+                int sid;
+                int pid = find_closest( rx, ry, sid );
+                center_coordinate( series[sid].x(pid), series[sid].y(pid) );
+            }
             redraw();
         } else if( wmain.mouse_click(1, mx, my) ) { // left button
             mx-=5;
@@ -330,7 +770,7 @@ namespace kortex {
             wmain.draw_line(gx0, gy0, gx1, gy1-2);
             float rx, ry;
             gxy_to_rxy(gx0, gy0, rx, ry );
-            wmain.write( gx1-15, gy1, num2str(rx,2) );
+            wmain.write( gx1-15, gy1, num2str(rx+x_origin,2) );
         }
 
         for( float y=0; y<=gh-2*params.y_margin; y+=yj ) {
@@ -347,13 +787,13 @@ namespace kortex {
             wmain.draw_line(gx0, gy0, gx1, gy1);
             float rx, ry;
             gxy_to_rxy(gx1, gy1, rx, ry );
-            if( ry>0 )
-                wmain.write( 30, gy1-5, num2str(ry,2) );
+            if( ry+y_origin>0 )
+                wmain.write( 30, gy1-5, num2str(ry+y_origin,2) );
             else
-                wmain.write( 17, gy1-5, num2str(ry,2) );
+                wmain.write( 17, gy1-5, num2str(ry+y_origin,2) );
         }
 
-        rxy_to_gxy( 0, 0, gx0, gy0 );
+        rxy_to_gxy( -x_origin, -y_origin, gx0, gy0 );
         wmain.set_color( 255, 0, 0 );
         wmain.mark( gx0, gy0, 5 );
         wmain.set_color( 125, 125, 110 );
@@ -364,36 +804,354 @@ namespace kortex {
 
     }
 
-    void Plot::draw_points() {
+    // a dense stream window marks its m4 decimated samples, the first,
+    // lowest, highest and last of each pixel column, as the line does
+    void Plot::draw_points( PlotSeries& s ) {
         int psz = int(2.0/params.zoom_factor+0.5);
-        wmain.set_color( 10, 255, 0 );
+        wmain.set_color( s.color );
         if( psz <  2 ) psz = 2;
         if( psz > 10 ) psz = 10;
-        for( int i=0; i<(int)yvals.size(); i++ ) {
-            float x = xvals[i];
-            float y = yvals[i];
-            float gx, gy;
-            rxy_to_gxy( x, y, gx, gy );
-            // printf(" %f %f -> %f %f \n", x, y, gx, gy );
-            wmain.mark( gx, gy, psz );
+        int n = s.size();
+        if( s.stream && n > 4*gw ) {
+            if( !is_decimation_valid( s ) )
+                decimate_line( s );
+            int m = (int)s.m4_y.size();
+            if( m == 0 ) return;
+            vector<float> gx( m ), gy( m );
+            vector<uchar> codes( m );
+            rxy_to_gxy( &s.m4_x[0], &s.m4_y[0], m, &gx[0], &gy[0] );
+            clip_codes( &gx[0], &gy[0], m, &codes[0] );
+            for( int k=0; k<m; k++ )
+                if( !codes[k] ) wmain.mark( gx[k], gy[k], psz );
+            return;
+        }
+
+        float rx[BATCH_SIZE], ry[BATCH_SIZE], gx[BATCH_SIZE], gy[BATCH_SIZE];
+        uchar codes[BATCH_SIZE];
+        for( int i0=0; i0<n; i0+=BATCH_SIZE ) {
+            int m = gather_samples( s, i0, BATCH_SIZE, rx, ry );
+            rxy_to_gxy( rx, ry, m, gx, gy );
+            clip_codes( gx, gy, m, codes );
+            for( int k=0; k<m; k++ )
+                if( !codes[k] ) wmain.mark( gx[k], gy[k], psz );
+        }
+    }
+
+    bool Plot::is_view_equal( const PlotParams& p, int w, int h ) const {
+        return w == gw && h == gh &&
+            p.x_shift     == params.x_shift     &&
+            p.y_shift     == params.y_shift     &&
+            p.zoom_factor == params.zoom_factor &&
+            p.x_margin    == params.x_margin    &&
+            p.y_margin    == params.y_margin    &&
+            p.x_min       == params.x_min       &&
+            p.x_max       == params.x_max       &&
+            p.y_min       == params.y_min       &&
+            p.y_max       == params.y_max;
+    }
+
+    bool Plot::is_decimation_valid( const PlotSeries& s ) const {
+        return s.m4_valid && is_view_equal( s.m4_params, s.m4_w, s.m4_h );
+    }
+
+    // m4 decimation of a series with monotone x: the visible samples are
+    // binned into pixel columns and only the first, min, max and last
+    // sample of each column are kept, in sample order. connecting them
+    // rasterizes like connecting every sample but costs O(plot width).
+    void Plot::decimate_line( PlotSeries& s ) {
+        s.m4_x.clear();
+        s.m4_y.clear();
+
+        int   n     = s.size();
+        int   ncols = gw - 2*params.x_margin;
+        float rx0, rx1, ry;
+        cxy_to_rxy( 0,     0, rx0, ry );
+        cxy_to_rxy( ncols, 0, rx1, ry );
+        double cw = double(rx1-rx0) / ncols;
+
+        // one sample beyond each end keeps the lines leaving the plot area
+        int i0 = s.lower_sample( rx0 );
+        int i1 = s.upper_sample( rx1 );
+        if( i0 > 0 ) i0--;
+        if( i1 > n-1 ) i1 = n-1;
+
+        int col = 0, f = -1, l = 0, mn = 0, mx = 0;
+        for( int i=i0; i<=i1+1; i++ ) {
+            int c = 0;
+            if( i <= i1 ) {
+                c = (int)floor( (s.x(i)-rx0)/cw );
+                c = std::max( -1, std::min( ncols, c ) );
+            }
+            if( f >= 0 && i <= i1 && c == col ) {
+                l = i;
+                float y = s.y(i);
+                if( y < s.y(mn) ) mn = i;
+                if( y > s.y(mx) ) mx = i;
+                continue;
+            }
+            if( f >= 0 ) {
+                int ids[4] = { f, mn, mx, l };
+                std::sort( ids, ids+4 );
+                for( int k=0; k<4; k++ ) {
+                    if( k && ids[k] == ids[k-1] ) continue;
+                    s.m4_x.push_back( s.x( ids[k] ) );
+                    s.m4_y.push_back( s.y( ids[k] ) );
+                }
+            }
+            col = c;
+            f = l = mn = mx = i;
         }
+
+        s.m4_params = params;
+        s.m4_w      = gw;
+        s.m4_h      = gh;
+        s.m4_valid  = true;
     }
 
-    void Plot::draw_line() {
+    void Plot::draw_line( PlotSeries& s ) {
         // printf("line\n");
-        wmain.set_color( 255, 255, 0 );
-        float gx0, gy0, gx1, gy1;
-        for( int i=0; i<(int)yvals.size()-1; i++ ) {
-            rxy_to_gxy( xvals[i], yvals[i], gx0, gy0 );
-            rxy_to_gxy( xvals[i+1], yvals[i+1], gx1, gy1 );
-            wmain.draw_line( gx0, gy0, gx1, gy1 );
+        wmain.set_color( s.color );
+
+        int n = s.size();
+        if( s.bmonotone && n > 4*gw ) {
+            if( !is_decimation_valid( s ) )
+                decimate_line( s );
+            int m = (int)s.m4_y.size();
+            if( m == 0 ) return;
+            vector<float> gx( m ), gy( m );
+            vector<uchar> codes( m );
+            rxy_to_gxy( &s.m4_x[0], &s.m4_y[0], m, &gx[0], &gy[0] );
+            clip_codes( &gx[0], &gy[0], m, &codes[0] );
+            draw_segments( &gx[0], &gy[0], &codes[0], m );
+            return;
+        }
+
+        // consecutive batches share their end point
+        float rx[BATCH_SIZE], ry[BATCH_SIZE], gx[BATCH_SIZE], gy[BATCH_SIZE];
+        uchar codes[BATCH_SIZE];
+        for( int i0=0; i0<n-1; i0+=BATCH_SIZE-1 ) {
+            int m = gather_samples( s, i0, BATCH_SIZE, rx, ry );
+            rxy_to_gxy( rx, ry, m, gx, gy );
+            clip_codes( gx, gy, m, codes );
+            draw_segments( gx, gy, codes, m );
+        }
+    }
+
+    // vertical lines from the x-axis to the samples. dense monotone series
+    // only draw the stems of the decimated samples: these hold the extremes
+    // of each pixel column and so cover the same pixels.
+    void Plot::draw_stems( PlotSeries& s ) {
+        wmain.set_color( s.color );
+        float gx, gy, gx0, gy0;
+
+        int n = s.size();
+        if( s.bmonotone && n > 4*gw ) {
+            if( !is_decimation_valid( s ) )
+                decimate_line( s );
+            for( int i=0; i<(int)s.m4_y.size(); i++ ) {
+                rxy_to_gxy( s.m4_x[i], s.m4_y[i], gx,  gy  );
+                rxy_to_gxy( s.m4_x[i], -y_origin, gx0, gy0 );
+                wmain.draw_line( gx0, gy0, gx, gy );
+            }
+            return;
+        }
+
+        for( int i=0; i<n; i++ ) {
+            rxy_to_gxy( s.x(i), s.y(i),    gx,  gy  );
+            rxy_to_gxy( s.x(i), -y_origin, gx0, gy0 );
+            wmain.draw_line( gx0, gy0, gx, gy );
+            wmain.mark( gx, gy, 2 );
+        }
+    }
+
+    namespace {
+        // black-red-yellow-white ramp
+        void heat_color( float t, uchar& r, uchar& g, uchar& b ) {
+            r = uchar( 255*std::min( 1.0f, std::max( 0.0f, 3*t     ) ) );
+            g = uchar( 255*std::min( 1.0f, std::max( 0.0f, 3*t-1.0f ) ) );
+            b = uchar( 255*std::min( 1.0f, std::max( 0.0f, 3*t-2.0f ) ) );
+        }
+    }
+
+    // bins the samples into a histogram with one bin per pixel of the plot
+    // area and maps the log counts through a heat ramp. the samples are
+    // binned in parallel into per-thread histograms.
+    void Plot::build_density( PlotSeries& s ) {
+        int aw = std::max( 0, int( gw-2*params.x_margin ) );
+        int ah = std::max( 0, int( gh-2*params.y_margin ) );
+        int n  = s.size();
+
+        double sx = (params.x_max-params.x_min) / aw * params.zoom_factor;
+        double sy = (params.y_max-params.y_min) / ah * params.zoom_factor;
+
+        vector<int> hist( aw*ah, 0 );
+        if( sx > 0 && sy > 0 ) {
+#pragma omp parallel
+            {
+                vector<int> local( aw*ah, 0 );
+#pragma omp for
+                for( int i=0; i<n; i++ ) {
+                    double cx = ( s.x(i)-params.x_shift )/sx;
+                    double cy = ( s.y(i)-params.y_shift )/sy;
+                    if( !( cx >= 0 && cx < aw && cy >= 0 && cy < ah ) ) continue;
+                    int c = (int)cx;
+                    int r = ah-1-(int)cy;
+                    local[ r*aw+c ]++;
+                }
+#pragma omp critical
+                for( int k=0; k<aw*ah; k++ )
+                    hist[k] += local[k];
+            }
+        }
+
+        int cmax = 1;
+        for( int k=0; k<aw*ah; k++ )
+            cmax = std::max( cmax, hist[k] );
+
+        uchar lut[256][3];
+        for( int l=0; l<256; l++ )
+            heat_color( 0.15f + 0.85f*l/255.0f, lut[l][0], lut[l][1], lut[l][2] );
+
+        s.dens_rgb.resize( 3*aw*ah );
+        s.dens_mask.resize( aw*ah );
+        float lnorm = 255.0f / log( 1.0f + cmax );
+        for( int k=0; k<aw*ah; k++ ) {
+            s.dens_mask[k] = hist[k] ? 255 : 0;
+            if( !hist[k] ) continue;
+            int l = std::min( 255, int( log( 1.0f + hist[k] ) * lnorm ) );
+            s.dens_rgb[3*k+0] = lut[l][0];
+            s.dens_rgb[3*k+1] = lut[l][1];
+            s.dens_rgb[3*k+2] = lut[l][2];
+        }
+
+        s.dens_params = params;
+        s.dens_w      = gw;
+        s.dens_h      = gh;
+        s.dens_valid  = true;
+    }
+
+    // the histogram is rebuilt only when the view changes so that redraws
+    // cost one pass over the plot area regardless of the sample count
+    void Plot::draw_density( PlotSeries& s ) {
+        if( !s.dens_valid || !is_view_equal( s.dens_params, s.dens_w, s.dens_h ) )
+            build_density( s );
+        int aw = std::max( 0, int( gw-2*params.x_margin ) );
+        int ah = std::max( 0, int( gh-2*params.y_margin ) );
+        if( aw == 0 || ah == 0 ) return;
+        wmain.draw_image( &s.dens_rgb[0], &s.dens_mask[0], params.x_margin, params.y_margin, aw, ah );
+    }
+
+    // only the samples or the pyramid blocks of the visible range are read.
+    // the level is picked so that a pixel column spans at least one block;
+    // columns are snapped to block boundaries, which is below a pixel. the
+    // visible range is found in double and samples are placed by their
+    // offset from the left edge so that long files keep their precision.
+    void Plot::draw_file( const PlotSeries& s ) {
+        const PlotFile* pf = s.file;
+        size_t n = pf->size();
+        if( n == 0 ) return;
+
+        int       ncols = gw - 2*params.x_margin;
+        double    spp   = tsx;
+        double    x0    = s.x_origin + params.x_shift; // index at the left edge
+        long long iv0   = (long long)floor( x0 );
+        float     fx0   = float( x0 - iv0 );
+
+        wmain.set_color( s.color );
+        float gx0, gy0, gx1, gy1, cx, cy;
+
+        if( spp <= 4.0 ) {
+            long long i0 = std::max( 0LL, iv0 - 1 );
+            long long i1 = std::min( (long long)n-1, (long long)ceil( x0 + spp*ncols ) + 1 );
+            if( i0 >= i1 ) return;
+            rxy_to_cxy( params.x_shift, float( pf->sample( i0 ) - s.y_origin ), cx, cy );
+            cxy_to_gxy( ( float( i0-iv0 ) - fx0 )*tix, cy, gx0, gy0 );
+            for( long long i=i0; i<i1; i++ ) {
+                rxy_to_cxy( params.x_shift, float( pf->sample( i+1 ) - s.y_origin ), cx, cy );
+                cxy_to_gxy( ( float( i+1-iv0 ) - fx0 )*tix, cy, gx1, gy1 );
+                wmain.draw_line( gx0, gy0, gx1, gy1 );
+                gx0 = gx1;
+                gy0 = gy1;
+            }
+            return;
+        }
+
+        int          l   = pf->level_for( spp );
+        size_t       bs  = ( l < 0 ) ? 1 : pf->block_size( l );
+        size_t       nb  = ( l < 0 ) ? n : pf->level_size( l );
+        const float* lvl = ( l < 0 ) ? NULL : pf->level( l );
+
+        bool  bprev = false;
+        float pmin  = 0.0f, pmax = 0.0f;
+        for( int c=0; c<ncols; c++ ) {
+            double s0 = x0 + c*spp;
+            double s1 = s0 + spp;
+            if( s1 <= 0 || s0 >= (double)n ) { bprev = false; continue; }
+            size_t b0 = (size_t)std::max( 0.0, floor( s0/bs ) );
+            size_t b1 = std::min( nb, (size_t)std::max( 0.0, ceil( s1/bs ) ) );
+            if( b1 <= b0 ) b1 = std::min( nb, b0+1 );
+
+            float vmin, vmax;
+            if( lvl ) {
+                vmin = lvl[2*b0];
+                vmax = lvl[2*b0+1];
+                for( size_t b=b0+1; b<b1; b++ ) {
+                    vmin = std::min( vmin, lvl[2*b  ] );
+                    vmax = std::max( vmax, lvl[2*b+1] );
+                }
+            } else {
+                vmin = vmax = pf->sample( b0 );
+                for( size_t i=b0+1; i<b1; i++ ) {
+                    float v = pf->sample( i );
+                    vmin = std::min( vmin, v );
+                    vmax = std::max( vmax, v );
+                }
+            }
+
+            // stretch to the previous column so that the trace stays connected
+            float lo = vmin, hi = vmax;
+            if( bprev ) {
+                lo = std::min( lo, pmax );
+                hi = std::max( hi, pmin );
+            }
+            float gx = c + params.x_margin;
+            rxy_to_gxy( params.x_shift, float( lo - s.y_origin ), gx0, gy0 );
+            rxy_to_gxy( params.x_shift, float( hi - s.y_origin ), gx1, gy1 );
+            wmain.draw_line( gx, gy0, gx, gy1 );
+
+            bprev = true;
+            pmin  = vmin;
+            pmax  = vmax;
+        }
+    }
+
+    void Plot::draw_legend() {
+        int y = params.y_margin + 5;
+        for( int k=0; k<(int)series.size(); k++ ) {
+            const PlotSeries& s = series[k];
+            if( s.legend.empty() ) continue;
+            int x = gw - params.x_margin - 10 - 8*(int)s.legend.size();
+            wmain.set_color( s.color );
+            wmain.draw_line( x-30, y+5, x-5, y+5 );
+            wmain.write( x, y, s.legend );
+            y += 15;
         }
     }
 
     void Plot::draw_data() {
-        // printf( "type %d\n", params.ptype );
-        if( params.ptype & PT_DOT  ) draw_points();
-        if( params.ptype & PT_LINE ) draw_line();
+        for( int k=0; k<(int)series.size(); k++ ) {
+            PlotSeries& s = series[k];
+            if( s.file ) {
+                draw_file( s );
+                continue;
+            }
+            // density replaces the markers of a scatter
+            if     ( s.ptype & PT_DENSITY ) draw_density( s );
+            else if( s.ptype & PT_DOT     ) draw_points ( s );
+            if     ( s.ptype & PT_STEM    ) draw_stems  ( s );
+            if     ( s.ptype & PT_LINE    ) draw_line   ( s );
+        }
+        draw_legend();
     }
 
     float Plot::y_range() const {
@@ -410,19 +1168,198 @@ namespace kortex {
         return gx1-gx0;
     }
 
-    int Plot::find_closest( float rx, float ry ) const {
+    namespace {
+        struct IndexLess {
+            const PlotSeries* s;
+            bool  xaxis;
+            bool operator()( int a, int b ) const {
+                return xaxis ? s->x(a) < s->x(b) : s->y(a) < s->y(b);
+            }
+        };
+
+        const int KD_LEAF_SIZE = 8;
+
+        // a node is pruned only if its lower bound is clearly worse than the
+        // best distance so that float rounding never changes the answer of
+        // the linear scan
+        inline bool is_prunable( double lower_bound, float dist ) {
+            return lower_bound > dist*(1.0+1e-4) + 1e-3;
+        }
+    }
+
+    // 2d tree built with alternating median splits. monotone series need
+    // it too: a search along x alone degrades to a scan of the series when
+    // the query is far from it vertically. stream windows change on every
+    // update and are scanned. it is built on the first search so that
+    // series nobody hovers cost no memory.
+    void PlotSeries::build_index() const {
+        kd_index.clear();
+        kd_valid = true;
+        if( stream ) return;
+
+        int ns = size();
+        kd_index.resize( ns );
+        for( int i=0; i<ns; i++ )
+            kd_index[i] = i;
+
+        vector< std::pair<int,int> > stack;
+        vector<int> depths;
+        stack.push_back( std::make_pair( 0, ns ) );
+        depths.push_back( 0 );
+        while( !stack.empty() ) {
+            int lo    = stack.back().first;
+            int hi    = stack.back().second;
+            int depth = depths.back();
+            stack.pop_back();
+            depths.pop_back();
+            if( hi-lo <= KD_LEAF_SIZE ) continue;
+
+            int mid = (lo+hi)/2;
+            IndexLess cmp;
+            cmp.s     = this;
+            cmp.xaxis = ( depth%2 == 0 );
+            std::nth_element( kd_index.begin()+lo, kd_index.begin()+mid, kd_index.begin()+hi, cmp );
+
+            stack.push_back( std::make_pair( lo, mid ) );
+            depths.push_back( depth+1 );
+            stack.push_back( std::make_pair( mid+1, hi ) );
+            depths.push_back( depth+1 );
+        }
+    }
+
+    // candidates are compared with exactly the screen distance of the linear
+    // scan. ties go to the lower sample index, as in the scan.
+    void Plot::test_closest( const PlotSeries& s, int i, float tx, float ty, int& id, float& dist ) const {
+        float qx, qy;
+        rxy_to_gxy( s.x(i), s.y(i), qx, qy );
+        float d = sq( qy-ty ) + sq( qx-tx );
+        if( d < dist || ( d == dist && i < id ) ) {
+            id   = i;
+            dist = d;
+        }
+    }
+
+    void Plot::search_index( const PlotSeries& s, int lo, int hi, int depth, float rx, float ry, double sx, double sy,
+                             float tx, float ty, int& id, float& dist ) const {
+        if( hi-lo <= KD_LEAF_SIZE ) {
+            float lx[KD_LEAF_SIZE], ly[KD_LEAF_SIZE], qx[KD_LEAF_SIZE], qy[KD_LEAF_SIZE];
+            int m = hi-lo;
+            for( int k=0; k<m; k++ ) {
+                lx[k] = s.x( s.kd_index[lo+k] );
+                ly[k] = s.y( s.kd_index[lo+k] );
+            }
+            rxy_to_gxy( lx, ly, m, qx, qy );
+            for( int k=0; k<m; k++ ) {
+                int   i = s.kd_index[lo+k];
+                float d = sq( qy[k]-ty ) + sq( qx[k]-tx );
+                if( d < dist || ( d == dist && i < id ) ) {
+                    id   = i;
+                    dist = d;
+                }
+            }
+            return;
+        }
+        int mid = (lo+hi)/2;
+        int p   = s.kd_index[mid];
+        double dp = ( depth%2 == 0 ) ? ( s.x(p)-rx )/sx : ( s.y(p)-ry )/sy;
+
+        test_closest( s, p, tx, ty, id, dist );
+        if( dp > 0 ) {
+            search_index( s, lo, mid, depth+1, rx, ry, sx, sy, tx, ty, id, dist );
+            if( !is_prunable( dp*dp, dist ) )
+                search_index( s, mid+1, hi, depth+1, rx, ry, sx, sy, tx, ty, id, dist );
+        } else {
+            search_index( s, mid+1, hi, depth+1, rx, ry, sx, sy, tx, ty, id, dist );
+            if( !is_prunable( dp*dp, dist ) )
+                search_index( s, lo, mid, depth+1, rx, ry, sx, sy, tx, ty, id, dist );
+        }
+    }
+
+    // nearest sample over all series. ties go to the earlier series.
+    int Plot::find_closest( float rx, float ry, int& sid ) const {
+        sid = 0;
+        int   id   = 0;
+        float best = 1e20;
+        for( int k=0; k<(int)series.size(); k++ ) {
+            if( series[k].size() == 0 ) continue;
+            float d;
+            int i = find_closest( series[k], rx, ry, d );
+            if( d < best ) {
+                best = d;
+                id   = i;
+                sid  = k;
+            }
+        }
+        return id;
+    }
+
+    // nearest sample of a series to (rx,ry) in screen space. the current
+    // aspect ratio is applied by scaling data distances with the view scale
+    // factors.
+    int Plot::find_closest( const PlotSeries& s, float rx, float ry, float& dist ) const {
+        int   id = 0;
+        float tx, ty;
+        rxy_to_gxy( rx, ry, tx, ty );
+        dist = 1e20;
+
+        int n = s.size();
+        if( n == 0 ) return 0;
+
+        double sx = tsx;
+        double sy = tsy;
+        if( !( sx > 0 ) || !( sy > 0 ) || !std::isfinite(sx) || !std::isfinite(sy) ) {
+            id = find_closest_linear( s, rx, ry );
+            test_closest( s, id, tx, ty, id, dist );
+            return id;
+        }
+
+        if( !s.stream ) {
+            if( !s.kd_valid ) s.build_index();
+            search_index( s, 0, n, 0, rx, ry, sx, sy, tx, ty, id, dist );
+            return id;
+        }
+
+        int c = s.lower_sample( rx );
+        for( int i=c; i<n; i++ ) {
+            double dx = ( s.x(i)-rx )/sx;
+            if( is_prunable( dx*dx, dist ) ) break;
+            test_closest( s, i, tx, ty, id, dist );
+        }
+        for( int i=c-1; i>=0; i-- ) {
+            double dx = ( s.x(i)-rx )/sx;
+            if( is_prunable( dx*dx, dist ) ) break;
+            test_closest( s, i, tx, ty, id, dist );
+        }
+        return id;
+    }
+
+    int Plot::closest_sample( int sid, double x, double y ) const {
+        passert_statement( sid >= 0 && sid < (int)series.size(), "invalid series" );
+        float d;
+        return find_closest( series[sid], float( x-x_origin ), float( y-y_origin ), d );
+    }
+
+    void Plot::data_to_screen( double x, double y, float& gx, float& gy ) const {
+        rxy_to_gxy( float( x-x_origin ), float( y-y_origin ), gx, gy );
+    }
+
+    int Plot::find_closest_linear( const PlotSeries& s, float rx, float ry ) const {
         float dist = 1e20;
         int id = 0;
 
-        float tx, ty, qx, qy;
+        float tx, ty;
         rxy_to_gxy(rx, ry, tx, ty );
 
-        for( int i=0; i<(int)yvals.size(); i++ ) {
-            rxy_to_gxy( xvals[i], yvals[i], qx, qy );
-            float d = sq( qy-ty ) + sq( qx-tx );
-            if( d < dist ) {
-                id = i;
-                dist = d;
+        float bx[BATCH_SIZE], by[BATCH_SIZE], qx[BATCH_SIZE], qy[BATCH_SIZE];
+        for( int i0=0; i0<s.size(); i0+=BATCH_SIZE ) {
+            int m = gather_samples( s, i0, BATCH_SIZE, bx, by );
+            rxy_to_gxy( bx, by, m, qx, qy );
+            for( int k=0; k<m; k++ ) {
+                float d = sq( qy[k]-ty ) + sq( qx[k]-tx );
+                if( d < dist ) {
+                    id = i0+k;
+                    dist = d;
+                }
             }
         }
 
@@ -449,6 +1386,18 @@ namespace kortex {
         pt.display();
     }
 
+    // each plot draws into its own headless window so the plots are
+    // rendered independently on all cores
+    void render_plots( const vector<Plot*>& plots, const vector<string>& files, int w, int h ) {
+        passert_statement( plots.size() == files.size(), "dimension mismatch" );
+        int n = (int)plots.size();
+#pragma omp parallel for schedule(dynamic)
+        for( int i=0; i<n; i++ ) {
+            assert_pointer( plots[i] );
+            plots[i]->render( w, h, files[i] );
+        }
+    }
+
 
 
 }
@@ -0,0 +1,258 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/plot_file.h"
+#include <kortex/check.h>
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace kortex {
+
+    namespace {
+        const char   pyramid_magic[8] = { 'K','P','L','T','P','Y','R','1' };
+        const int    pyramid_base     = 64;      // samples per level 0 block
+        const size_t pyramid_header   = 64;      // bytes reserved for the header
+
+        struct PyramidHeader {
+            char      magic[8];
+            long long n;
+            int       type;
+            int       base;
+            long long src_size;
+            long long src_mtime;
+            int       nlevels;
+            int       reserved;
+        };
+
+        int sample_bytes( int type ) {
+            switch( type ) {
+            case PST_DOUBLE: return 8;
+            case PST_INT16 : return 2;
+            case PST_INT32 : return 4;
+            case PST_INT64 : return 8;
+            default        : return 4;
+            }
+        }
+
+        template<typename T>
+        void block_range( const T* data, size_t i0, size_t i1, float& vmin, float& vmax ) {
+            T mn = data[i0];
+            T mx = data[i0];
+            for( size_t i=i0+1; i<i1; i++ ) {
+                if( data[i] < mn ) mn = data[i];
+                if( data[i] > mx ) mx = data[i];
+            }
+            vmin = (float)mn;
+            vmax = (float)mx;
+        }
+
+        void block_range( const void* data, int type, size_t i0, size_t i1, float& vmin, float& vmax ) {
+            switch( type ) {
+            case PST_DOUBLE: block_range( (const double* )data, i0, i1, vmin, vmax ); break;
+            case PST_INT16 : block_range( (const int16_t*)data, i0, i1, vmin, vmax ); break;
+            case PST_INT32 : block_range( (const int32_t*)data, i0, i1, vmin, vmax ); break;
+            case PST_INT64 : block_range( (const int64_t*)data, i0, i1, vmin, vmax ); break;
+            default        : block_range( (const float*  )data, i0, i1, vmin, vmax ); break;
+            }
+        }
+    }
+
+    PlotFile::PlotFile() {
+        fd         = -1;
+        data       = NULL;
+        data_bytes = 0;
+        type       = PST_FLOAT;
+        n          = 0;
+        pyr        = NULL;
+        pyr_bytes  = 0;
+        base       = pyramid_base;
+        nlevels    = 0;
+        vmin_all   = 0.0f;
+        vmax_all   = 1.0f;
+    }
+
+    PlotFile::~PlotFile() {
+        close();
+    }
+
+    void PlotFile::close() {
+        if( data ) munmap( data, data_bytes );
+        if( pyr  ) munmap( pyr,  pyr_bytes  );
+        if( fd >= 0 ) ::close( fd );
+        fd         = -1;
+        data       = NULL;
+        data_bytes = 0;
+        pyr        = NULL;
+        pyr_bytes  = 0;
+        n          = 0;
+        nlevels    = 0;
+        loffset.clear();
+        vmin_all   = 0.0f;
+        vmax_all   = 1.0f;
+    }
+
+    void PlotFile::open( const string& file, int sample_type ) {
+        close();
+        type = sample_type;
+
+        fd = ::open( file.c_str(), O_RDONLY );
+        passert_statement( fd >= 0, "could not open sample file" );
+        struct stat st;
+        passert_statement( fstat( fd, &st ) == 0, "could not stat sample file" );
+
+        n          = (size_t)st.st_size / sample_bytes( type );
+        data_bytes = n * sample_bytes( type );
+        if( n == 0 ) return;
+
+        data = mmap( NULL, data_bytes, PROT_READ, MAP_SHARED, fd, 0 );
+        passert_statement( data != MAP_FAILED, "could not map sample file" );
+
+        string pfile = file + ".pyr";
+        if( !map_pyramid( pfile, st.st_size, st.st_mtime ) ) {
+            build_pyramid( pfile, st.st_size, st.st_mtime );
+            passert_statement( map_pyramid( pfile, st.st_size, st.st_mtime ), "could not map pyramid" );
+        }
+
+        // views far out read the coarse levels only
+        madvise( data, data_bytes, MADV_RANDOM );
+
+        const float* top = level( nlevels-1 );
+        vmin_all = top[0];
+        vmax_all = top[1];
+    }
+
+    // level sizes and offsets follow from the sample count alone
+    void PlotFile::set_levels() {
+        loffset.clear();
+        size_t off = pyramid_header / sizeof(float);
+        size_t ls  = ( n + base-1 ) / base;
+        while( 1 ) {
+            loffset.push_back( off );
+            off += 2*ls;
+            if( ls == 1 ) break;
+            ls = ( ls+1 )/2;
+        }
+        loffset.push_back( off );
+        nlevels = (int)loffset.size()-1;
+    }
+
+    size_t PlotFile::level_size( int l ) const {
+        return ( loffset[l+1] - loffset[l] ) / 2;
+    }
+
+    const float* PlotFile::level( int l ) const {
+        return (const float*)pyr + loffset[l];
+    }
+
+    int PlotFile::level_for( double spp ) const {
+        int l = -1;
+        while( l+1 < nlevels && (double)block_size( l+1 ) <= spp )
+            l++;
+        return l;
+    }
+
+    bool PlotFile::map_pyramid( const string& pfile, long long src_size, long long src_mtime ) {
+        int pfd = ::open( pfile.c_str(), O_RDONLY );
+        if( pfd < 0 ) return false;
+
+        set_levels();
+        size_t expected = loffset.back() * sizeof(float);
+
+        struct stat st;
+        bool valid = ( fstat( pfd, &st ) == 0 && (size_t)st.st_size == expected );
+        if( valid ) {
+            pyr       = mmap( NULL, expected, PROT_READ, MAP_SHARED, pfd, 0 );
+            pyr_bytes = expected;
+            if( pyr == MAP_FAILED ) {
+                pyr   = NULL;
+                valid = false;
+            }
+        }
+        ::close( pfd );
+        if( !valid ) return false;
+
+        const PyramidHeader* h = (const PyramidHeader*)pyr;
+        if( memcmp( h->magic, pyramid_magic, 8 ) || h->n != (long long)n || h->type != type ||
+            h->base != base || h->src_size != src_size || h->src_mtime != src_mtime || h->nlevels != nlevels ) {
+            munmap( pyr, pyr_bytes );
+            pyr       = NULL;
+            pyr_bytes = 0;
+            return false;
+        }
+        return true;
+    }
+
+    // the pyramid is written straight into the mapped sidecar: level 0 is
+    // reduced from the samples in parallel over blocks while the samples
+    // stream through once, each upper level from the level below. the
+    // header goes in last so an interrupted build is never reused.
+    void PlotFile::build_pyramid( const string& pfile, long long src_size, long long src_mtime ) {
+        set_levels();
+        size_t bytes = loffset.back() * sizeof(float);
+        string tfile = pfile + ".tmp";
+
+        int pfd = ::open( tfile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 );
+        passert_statement( pfd >= 0, "could not create pyramid file" );
+        passert_statement( ftruncate( pfd, bytes ) == 0, "could not size pyramid file" );
+        void* out = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, pfd, 0 );
+        passert_statement( out != MAP_FAILED, "could not map pyramid file" );
+
+        madvise( data, data_bytes, MADV_SEQUENTIAL );
+
+        float* l0 = (float*)out + loffset[0];
+        long long nb = (long long)level_size( 0 );
+#pragma omp parallel for schedule(static)
+        for( long long b=0; b<nb; b++ ) {
+            size_t i0 = (size_t)b*base;
+            size_t i1 = std::min( n, i0+base );
+            block_range( data, type, i0, i1, l0[2*b], l0[2*b+1] );
+        }
+
+        for( int l=1; l<nlevels; l++ ) {
+            const float* src = (const float*)out + loffset[l-1];
+            float*       dst = (float*)out + loffset[l];
+            long long    ns  = (long long)level_size( l-1 );
+            long long    nd  = (long long)level_size( l );
+#pragma omp parallel for schedule(static)
+            for( long long b=0; b<nd; b++ ) {
+                long long c = std::min( 2*b+1, ns-1 );
+                dst[2*b  ] = std::min( src[4*b  ], src[2*c  ] );
+                dst[2*b+1] = std::max( src[4*b+1], src[2*c+1] );
+            }
+        }
+
+        PyramidHeader h;
+        memset( &h, 0, sizeof(h) );
+        memcpy( h.magic, pyramid_magic, 8 );
+        h.n         = (long long)n;
+        h.type      = type;
+        h.base      = base;
+        h.src_size  = src_size;
+        h.src_mtime = src_mtime;
+        h.nlevels   = nlevels;
+        memcpy( out, &h, sizeof(h) );
+
+        msync( out, bytes, MS_SYNC );
+        munmap( out, bytes );
+        ::close( pfd );
+        passert_statement( rename( tfile.c_str(), pfile.c_str() ) == 0, "could not save pyramid file" );
+    }
+
+}
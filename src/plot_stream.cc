@@ -0,0 +1,89 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/plot_stream.h"
+#include <kortex/check.h>
+
+#include <algorithm>
+
+namespace kortex {
+
+    PlotStream::PlotStream( int window_size, int burst_size ) {
+        passert_statement( window_size > 0 && burst_size > 0, "invalid stream size" );
+        window = window_size;
+
+        // the ring holds the published window plus the samples the producer
+        // may write between two updates
+        size_t capacity = 1;
+        while( capacity < (size_t)window_size + (size_t)burst_size )
+            capacity <<= 1;
+        mask = capacity-1;
+        xbuf.resize( capacity );
+        ybuf.resize( capacity );
+
+        head     = 0;
+        tail     = 0;
+        ndropped = 0;
+        wstart   = 0;
+        wend     = 0;
+        seen     = 0;
+    }
+
+    int PlotStream::push( float x, float y ) {
+        return push( &x, &y, 1 );
+    }
+
+    int PlotStream::push( const float* xs, const float* ys, int n ) {
+        size_t h = head.load( std::memory_order_relaxed );
+        size_t t = tail.load( std::memory_order_acquire );
+        size_t space = ( mask+1 ) - ( h-t );
+        int m = (int)std::min( (size_t)n, space );
+        for( int i=0; i<m; i++ ) {
+            xbuf[ (h+i) & mask ] = xs[i];
+            ybuf[ (h+i) & mask ] = ys[i];
+        }
+        head.store( h+m, std::memory_order_release );
+        if( m < n ) ndropped.fetch_add( n-m, std::memory_order_relaxed );
+        return m;
+    }
+
+    void PlotStream::update() {
+        size_t h     = head.load( std::memory_order_acquire );
+        size_t start = ( h > (size_t)window ) ? h-window : 0;
+
+        // samples older than the new window never enter the deques
+        for( size_t s=std::max( seen, start ); s<h; s++ ) {
+            float v = ybuf[ s & mask ];
+            while( !dmax.empty() && ybuf[ dmax.back() & mask ] <= v ) dmax.pop_back();
+            while( !dmin.empty() && ybuf[ dmin.back() & mask ] >= v ) dmin.pop_back();
+            dmax.push_back( s );
+            dmin.push_back( s );
+        }
+        seen = h;
+        while( !dmax.empty() && dmax.front() < start ) dmax.pop_front();
+        while( !dmin.empty() && dmin.front() < start ) dmin.pop_front();
+
+        wstart = start;
+        wend   = h;
+        tail.store( start, std::memory_order_release );
+    }
+
+    float PlotStream::y_min() const {
+        return dmin.empty() ? 0.0f : ybuf[ dmin.front() & mask ];
+    }
+
+    float PlotStream::y_max() const {
+        return dmax.empty() ? 1.0f : ybuf[ dmax.front() & mask ];
+    }
+
+}
@@ -0,0 +1,148 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/rect_batch.h"
+
+#include <cstring>
+
+#ifdef WITH_SSE
+#include <emmintrin.h>
+#endif
+
+namespace kortex {
+
+    namespace {
+#ifdef WITH_SSE
+        // lane masks of 4 comparisons -> 4 bytes of 0/1
+        inline void store_mask( __m128i m, uchar* mask ) {
+            m = _mm_and_si128( m, _mm_set1_epi32( 1 ) );
+            m = _mm_packs_epi32 ( m, m );
+            m = _mm_packus_epi16( m, m );
+            int packed = _mm_cvtsi128_si32( m );
+            memcpy( mask, &packed, 4 );
+        }
+
+        inline int push_hits( int bits, int i, int* ids, int nh ) {
+            while( bits ) {
+                int b = __builtin_ctz( bits );
+                ids[nh++] = i+b;
+                bits &= bits-1;
+            }
+            return nh;
+        }
+#endif
+    }
+
+    void is_inside( const Rect2f& r, const float* xs, const float* ys, int n, uchar* mask ) {
+        int i = 0;
+#ifdef WITH_SSE
+        __m128 lx = _mm_set1_ps( r.lx ), ux = _mm_set1_ps( r.ux );
+        __m128 ly = _mm_set1_ps( r.ly ), uy = _mm_set1_ps( r.uy );
+        for( ; i+4<=n; i+=4 ) {
+            __m128 x = _mm_loadu_ps( xs+i );
+            __m128 y = _mm_loadu_ps( ys+i );
+            __m128 m = _mm_and_ps( _mm_cmpge_ps( x, lx ), _mm_cmplt_ps( x, ux ) );
+            m = _mm_and_ps( m, _mm_and_ps( _mm_cmpge_ps( y, ly ), _mm_cmplt_ps( y, uy ) ) );
+            store_mask( _mm_castps_si128( m ), mask+i );
+        }
+#endif
+        for( ; i<n; i++ )
+            mask[i] = r.is_inside( xs[i], ys[i] );
+    }
+
+    void is_inside( const Rect2i& r, const int* xs, const int* ys, int n, uchar* mask ) {
+        int i = 0;
+#ifdef WITH_SSE
+        __m128i lx = _mm_set1_epi32( r.lx ), ux = _mm_set1_epi32( r.ux );
+        __m128i ly = _mm_set1_epi32( r.ly ), uy = _mm_set1_epi32( r.uy );
+        for( ; i+4<=n; i+=4 ) {
+            __m128i x = _mm_loadu_si128( (const __m128i*)( xs+i ) );
+            __m128i y = _mm_loadu_si128( (const __m128i*)( ys+i ) );
+            // inside: !(lx > x) && ux > x && !(ly > y) && uy > y
+            __m128i m = _mm_andnot_si128( _mm_cmpgt_epi32( lx, x ), _mm_cmpgt_epi32( ux, x ) );
+            m = _mm_and_si128( m, _mm_andnot_si128( _mm_cmpgt_epi32( ly, y ), _mm_cmpgt_epi32( uy, y ) ) );
+            store_mask( m, mask+i );
+        }
+#endif
+        for( ; i<n; i++ )
+            mask[i] = r.is_inside( xs[i], ys[i] );
+    }
+
+    int rects_containing( const float* lx, const float* ly, const float* ux, const float* uy, int n,
+                          float x, float y, int* ids ) {
+        int i  = 0;
+        int nh = 0;
+#ifdef WITH_SSE
+        __m128 vx = _mm_set1_ps( x );
+        __m128 vy = _mm_set1_ps( y );
+        for( ; i+4<=n; i+=4 ) {
+            __m128 m = _mm_and_ps( _mm_cmpge_ps( vx, _mm_loadu_ps( lx+i ) ), _mm_cmplt_ps( vx, _mm_loadu_ps( ux+i ) ) );
+            m = _mm_and_ps( m, _mm_and_ps( _mm_cmpge_ps( vy, _mm_loadu_ps( ly+i ) ),
+                                           _mm_cmplt_ps( vy, _mm_loadu_ps( uy+i ) ) ) );
+            nh = push_hits( _mm_movemask_ps( m ), i, ids, nh );
+        }
+#endif
+        for( ; i<n; i++ ) {
+            if( x>=lx[i] && x<ux[i] && y>=ly[i] && y<uy[i] )
+                ids[nh++] = i;
+        }
+        return nh;
+    }
+
+    int rects_overlapping( const float* lx, const float* ly, const float* ux, const float* uy, int n,
+                           const Rect2f& q, int* ids ) {
+        int i  = 0;
+        int nh = 0;
+#ifdef WITH_SSE
+        __m128 qlx = _mm_set1_ps( q.lx ), qux = _mm_set1_ps( q.ux );
+        __m128 qly = _mm_set1_ps( q.ly ), quy = _mm_set1_ps( q.uy );
+        for( ; i+4<=n; i+=4 ) {
+            __m128 m = _mm_and_ps( _mm_cmplt_ps( _mm_loadu_ps( lx+i ), qux ), _mm_cmplt_ps( qlx, _mm_loadu_ps( ux+i ) ) );
+            m = _mm_and_ps( m, _mm_and_ps( _mm_cmplt_ps( _mm_loadu_ps( ly+i ), quy ),
+                                           _mm_cmplt_ps( qly, _mm_loadu_ps( uy+i ) ) ) );
+            nh = push_hits( _mm_movemask_ps( m ), i, ids, nh );
+        }
+#endif
+        for( ; i<n; i++ ) {
+            if( lx[i] < q.ux && q.lx < ux[i] && ly[i] < q.uy && q.ly < uy[i] )
+                ids[nh++] = i;
+        }
+        return nh;
+    }
+
+    void RectSet::clear() {
+        lx.clear(); ly.clear();
+        ux.clear(); uy.clear();
+    }
+
+    void RectSet::add( const Rect2f& r ) {
+        lx.push_back( r.lx ); ly.push_back( r.ly );
+        ux.push_back( r.ux ); uy.push_back( r.uy );
+    }
+
+    Rect2f RectSet::rect( int i ) const {
+        Rect2f r;
+        r.lx = lx[i]; r.ly = ly[i];
+        r.ux = ux[i]; r.uy = uy[i];
+        return r;
+    }
+
+    int RectSet::containing( float x, float y, int* ids ) const {
+        return rects_containing( lx.data(), ly.data(), ux.data(), uy.data(), size(), x, y, ids );
+    }
+
+    int RectSet::overlapping( const Rect2f& q, int* ids ) const {
+        return rects_overlapping( lx.data(), ly.data(), ux.data(), uy.data(), size(), q, ids );
+    }
+
+}
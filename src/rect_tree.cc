@@ -0,0 +1,141 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/rect_tree.h"
+#include "kortex/rect_batch.h"
+#include <kortex/check.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace kortex {
+
+    namespace {
+        const int max_fanout = 64;
+
+        struct CenterLess {
+            const vector<Rect2f>* r;
+            bool by_x;
+            bool operator()( int a, int b ) const {
+                const Rect2f& ra = (*r)[a];
+                const Rect2f& rb = (*r)[b];
+                if( by_x ) return ra.lx+ra.ux < rb.lx+rb.ux;
+                else       return ra.ly+ra.uy < rb.ly+rb.uy;
+            }
+        };
+    }
+
+    RectTree::RectTree() {
+        fanout = 16;
+    }
+
+    void RectTree::clear() {
+        levels.clear();
+        order.clear();
+    }
+
+    // sort-tile-recursive: the rects are sorted by center x, cut into
+    // vertical slices of about sqrt(n/fanout) leaves each, and every slice
+    // is sorted by center y. consecutive runs of fanout boxes then form the
+    // nodes of the next level.
+    void RectTree::build( const vector<Rect2f>& rects, int fo ) {
+        passert_statement( fo >= 2 && fo <= max_fanout, "invalid r-tree fanout" );
+        clear();
+        fanout = fo;
+        int n = (int)rects.size();
+        if( n == 0 ) return;
+
+        order.resize( n );
+        for( int i=0; i<n; i++ ) order[i] = i;
+
+        CenterLess cmp;
+        cmp.r    = &rects;
+        cmp.by_x = true;
+        std::sort( order.begin(), order.end(), cmp );
+
+        int nleaves = ( n + fanout-1 ) / fanout;
+        int nslices = (int)ceil( sqrt( (double)nleaves ) );
+        int sslice  = ( ( nleaves + nslices-1 ) / nslices ) * fanout;
+        cmp.by_x = false;
+        for( int s=0; s<n; s+=sslice )
+            std::sort( order.begin()+s, order.begin()+std::min( n, s+sslice ), cmp );
+
+        levels.push_back( Level() );
+        Level& l0 = levels.back();
+        l0.lx.resize( n ); l0.ly.resize( n );
+        l0.ux.resize( n ); l0.uy.resize( n );
+        for( int i=0; i<n; i++ ) {
+            const Rect2f& r = rects[ order[i] ];
+            l0.lx[i] = r.lx; l0.ly[i] = r.ly;
+            l0.ux[i] = r.ux; l0.uy[i] = r.uy;
+        }
+
+        while( (int)levels.back().lx.size() > fanout ) {
+            const Level& lc = levels.back();
+            int nc = (int)lc.lx.size();
+            Level lp;
+            for( int c=0; c<nc; c+=fanout ) {
+                int ce = std::min( nc, c+fanout );
+                float lx = lc.lx[c], ly = lc.ly[c], ux = lc.ux[c], uy = lc.uy[c];
+                for( int k=c+1; k<ce; k++ ) {
+                    lx = std::min( lx, lc.lx[k] ); ly = std::min( ly, lc.ly[k] );
+                    ux = std::max( ux, lc.ux[k] ); uy = std::max( uy, lc.uy[k] );
+                }
+                lp.lx.push_back( lx ); lp.ly.push_back( ly );
+                lp.ux.push_back( ux ); lp.uy.push_back( uy );
+                lp.first.push_back( c );
+            }
+            lp.first.push_back( nc );
+            levels.push_back( lp );
+        }
+    }
+
+    void RectTree::query_point( int l, int i0, int i1, float x, float y, vector<int>& ids ) const {
+        const Level& lv = levels[l];
+        int hits[max_fanout];
+        int nh = rects_containing( &lv.lx[i0], &lv.ly[i0], &lv.ux[i0], &lv.uy[i0], i1-i0, x, y, hits );
+        for( int k=0; k<nh; k++ ) {
+            int i = i0 + hits[k];
+            if( l == 0 ) ids.push_back( order[i] );
+            else         query_point( l-1, lv.first[i], lv.first[i+1], x, y, ids );
+        }
+    }
+
+    void RectTree::query_rect( int l, int i0, int i1, const Rect2f& q, vector<int>& ids ) const {
+        const Level& lv = levels[l];
+        int hits[max_fanout];
+        int nh = rects_overlapping( &lv.lx[i0], &lv.ly[i0], &lv.ux[i0], &lv.uy[i0], i1-i0, q, hits );
+        for( int k=0; k<nh; k++ ) {
+            int i = i0 + hits[k];
+            if( l == 0 ) ids.push_back( order[i] );
+            else         query_rect( l-1, lv.first[i], lv.first[i+1], q, ids );
+        }
+    }
+
+    void RectTree::query_point( float x, float y, vector<int>& ids ) const {
+        ids.clear();
+        if( levels.empty() ) return;
+        int top = (int)levels.size()-1;
+        query_point( top, 0, (int)levels[top].lx.size(), x, y, ids );
+        std::sort( ids.begin(), ids.end() );
+    }
+
+    void RectTree::query_rect( const Rect2f& q, vector<int>& ids ) const {
+        ids.clear();
+        if( levels.empty() ) return;
+        int top = (int)levels.size()-1;
+        query_rect( top, 0, (int)levels[top].lx.size(), q, ids );
+        std::sort( ids.begin(), ids.end() );
+    }
+
+}
@@ -0,0 +1,77 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+#include "kortex/view_transform.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace kortex {
+
+    // fits the whole image into a dw x dh display and centers it
+    void ViewTransform::fit( int iw, int ih, int dw, int dh ) {
+        if( dw <= 0 || dh <= 0 ) return;
+        scale = std::max( double(iw)/dw, double(ih)/dh );
+        if( scale <= 0.0 ) scale = 1.0;
+        x0 = ( iw - dw*scale ) / 2.0;
+        y0 = ( ih - dh*scale ) / 2.0;
+        snap();
+    }
+
+    // zooms by zf keeping the image point under display pixel (dx,dy)
+    // fixed. zf < 1 zooms in.
+    void ViewTransform::zoom( double dx, double dy, double zf ) {
+        double ix, iy;
+        display_to_image( dx, dy, ix, iy );
+        scale *= zf;
+        if( scale < 1.0/64.0 ) scale = 1.0/64.0;
+        if( scale > 1024.0   ) scale = 1024.0;
+        x0 = ix - dx*scale;
+        y0 = iy - dy*scale;
+        snap();
+    }
+
+    // moves the viewport by (ddx,ddy) display pixels
+    void ViewTransform::pan( double ddx, double ddy ) {
+        x0 += ddx * scale;
+        y0 += ddy * scale;
+        snap();
+    }
+
+    // aligns the origin to a whole display pixel so that renderings of the
+    // same view at different display offsets sample identical pixels
+    void ViewTransform::snap() {
+        x0 = floor( x0/scale + 0.5 ) * scale;
+        y0 = floor( y0/scale + 0.5 ) * scale;
+    }
+
+    void ViewTransform::display_to_image( double dx, double dy, double& ix, double& iy ) const {
+        ix = x0 + dx * scale;
+        iy = y0 + dy * scale;
+    }
+
+    void ViewTransform::image_to_display( double ix, double iy, double& dx, double& dy ) const {
+        dx = ( ix - x0 ) / scale;
+        dy = ( iy - y0 ) / scale;
+    }
+
+    void ViewTransform::visible_region( int dw, int dh, double& ix0, double& iy0, double& ix1, double& iy1 ) const {
+        display_to_image(  0,  0, ix0, iy0 );
+        display_to_image( dw, dh, ix1, iy1 );
+    }
+
+    bool ViewTransform::operator==( const ViewTransform& v ) const {
+        return scale == v.scale && x0 == v.x0 && y0 == v.y0;
+    }
+
+}
@@ -0,0 +1,89 @@
+// ---------------------------------------------------------------------------
+//
+// This file is part of the <kortex> library suite
+//
+// Copyright (C) 2013 Engin Tola
+//
+// See LICENSE file for license information.
+//
+// author: Engin Tola
+// e-mail: engintola@gmail.com
+// web   : http://www.engintola.com
+//
+// ---------------------------------------------------------------------------
+//
+// live viewer of the frames a FramePublisher puts into shared memory. the
+// viewer only reads the ring: when it cannot keep up it skips to the newest
+// frame and the producer never notices.
+//
+// usage: kortex-view ring-name
+//
+// ---------------------------------------------------------------------------
+#include "kortex/frame_publisher.h"
+#include "kortex/display_list.h"
+#include "kortex/gui_window.h"
+#include "kortex/opencv_extensions.h"
+#include <kortex/image.h>
+
+#include <cstdio>
+#include <unistd.h>
+
+using namespace std;
+using namespace kortex;
+
+int main( int argc, char** argv ) {
+    if( argc < 2 ) {
+        fprintf( stderr, "usage: %s ring-name\n", argv[0] );
+        return 1;
+    }
+    string name = argv[1];
+
+    FrameSubscriber ring;
+    if( !ring.open( name ) ) {
+        fprintf( stderr, "waiting for publisher %s\n", name.c_str() );
+        while( !ring.open( name ) )
+            usleep( 200000 );
+    }
+
+    GUIWindow   win( name );
+    Image       img;
+    Image       conv;
+    DisplayList overlay;
+    bool        created = false;
+    while( 1 ) {
+        if( ring.latest( &img, &overlay ) ) {
+            // the display takes 8 bit color and 8 bit or float gray, the
+            // other types a publisher may send are converted first
+            const Image* src = &img;
+            ImageType    t   = img.type();
+            if( t != IT_U_GRAY && t != IT_F_GRAY && t != IT_U_PRGB ) {
+                conv.copy( &img );
+                conv.convert( img.ch() == 1 ? IT_F_GRAY : IT_U_PRGB );
+                src = &conv;
+            }
+            float vmin = 0.0f, vmax = 255.0f;
+            if( src->precision() != TYPE_UCHAR )
+                image_range( src, vmin, vmax );
+            win.set_image( src, vmin, vmax, false );
+            if( overlay.size_in_bytes() ) {
+                overlay.replay( win.get_original_display() );
+                win.reset_display();
+            }
+            if( !created ) {
+                win.create( 0 );
+                win.resize( src->w(), src->h() );
+                created = true;
+            }
+            win.refresh();
+        }
+        if( !created ) {
+            usleep( 10000 );
+            continue;
+        }
+        if( win.wait( 10 ) == 'q' ) break;
+    }
+
+    printf( "frames %llu skipped %llu\n", (unsigned long long)ring.frame_id(),
+            (unsigned long long)ring.no_skipped() );
+    return 0;
+}